@@ -24,7 +24,7 @@
 #define ELF_PATH "I:/Vitis_Files/Pipeline_Tests/Global_Core_Revised/Benchmarks/rv32ui-p-benchmarks/m-ext/multiply.riscv"
 
 // 2. Debug Switches
-const bool ENABLE_CORE_DEBUG = false;
+const bool ENABLE_CORE_DEBUG = false; // Stage logs need a -DCORE_TRACE=1 build
 const bool ENABLE_MEMORY_INSPECTION = false; 
 
 // ============================================================================
@@ -34,7 +34,7 @@ ap_uint<32> ram[RAM_SIZE];
 
 extern void riscv_init();
 // UPDATED SIGNATURE: Now accepts the cycle count
-extern void riscv_step(volatile uint32_t* ram, int max_cycles, int* cycles_output);
+extern void riscv_step(volatile uint32_t* imem, volatile uint32_t* dmem, int max_cycles, int* cycles_output);
 
 int main(int argc, char* argv[])
 {
@@ -68,6 +68,9 @@ int main(int argc, char* argv[])
     std::cout << "\n[TESTBENCH] Initializing Core...\n";
     
     CORE_DEBUG = ENABLE_CORE_DEBUG; 
+    if (ENABLE_CORE_DEBUG && !CORE_TRACE) {
+        std::cout << "[TESTBENCH] WARNING: Core logging is compiled out, rebuild with -DCORE_TRACE=1\n";
+    }
     
     riscv_init();
 
@@ -79,7 +82,7 @@ int main(int argc, char* argv[])
 
     // Single Call to Hardware
     // The hardware will loop internally until it hits the ecall
-    riscv_step((volatile uint32_t*)ram, 500000, &final_cycle_count);
+    riscv_step((volatile uint32_t*)ram, (volatile uint32_t*)ram, 500000, &final_cycle_count);
 
     // [MODIFIED] Print the Result
     std::cout << "--------------------------------------------------\n";
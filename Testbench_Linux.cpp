@@ -2,21 +2,60 @@
 #include <fstream>
 #include <vector>
 #include "core.h" // Ensures we see the global variables ENTRY_PC and DTB_ADDR
+#include "guest_memory.h"
+#include "checkpoint.h"
+#include "profiler.h"
+#include "calltrace.h"
+#include "insn_trace.h"
+#include "ref_iss.h"
+
+// ============================================================================
+//  USER CONFIGURATION SWITCHES
+// ============================================================================
+
+// 1. Run Length (stop once mcycle reaches this; 0 = run forever)
+#define RUN_CYCLES      10000000
+
+// 2. Checkpoints ("" = off)
+//    CHECKPOINT_LOAD: resume from this file instead of booting Image
+//    CHECKPOINT_SAVE: written when the run stops (e.g. a post-boot image)
+#define CHECKPOINT_LOAD ""
+#define CHECKPOINT_SAVE ""
+
+// 3. Profiler: hot kernel functions at the end of the run
+//    PROFILE_SYMBOLS: the kernel's System.map ("" = report raw addresses)
+const bool ENABLE_PROFILER = false;
+#define PROFILE_SYMBOLS ""
+#define PROFILE_FOLDED  "linux.folded"
+
+// 4. Call Graph: which init functions the boot spends its cycles in
+//    (named from PROFILE_SYMBOLS as well)
+const bool ENABLE_CALLGRAPH = false;
+#define CALLGRAPH_FOLDED "linux_calls.folded" // Collapsed call paths ("" = off)
+#define CHROME_TRACE     ""                   // Timeline JSON for ui.perfetto.dev ("" = off)
+
+// 5. Instruction Trace: every retired instruction, binary (see insn_trace.h)
+//    Roughly 2-4 bytes per instruction; disables the JIT while recording
+#define TRACE_FILE ""
+
+// 6. Lockstep Check: run the reference ISS (ref_iss.h) beside the core and
+//    stop at the first divergence. Excludes TRACE_FILE; disables the JIT.
+const bool ENABLE_LOCKSTEP = false;
+
+// ============================================================================
 
 // --------------------------------------------------------------------------
 // SIMULATED RAM SETUP
 // --------------------------------------------------------------------------
-// 128MB = 33,554,432 words
-#define RAM_SIZE_BYTES (128 * 1024 * 1024) 
-#define RAM_SIZE_WORDS (RAM_SIZE_BYTES / 4)
-
-// We use ap_uint<32> for the array, but we will cast it when calling the core
-ap_uint<32> ram[RAM_SIZE_WORDS];
+// 128MB = 33,554,432 words, reserved sparsely (see guest_memory.h)
+static GuestMemory ram;
 
 // --------------------------------------------------------------------------
 // HELPER: Load Raw Binary File to RAM
 // --------------------------------------------------------------------------
 bool load_binary_to_ram(const char* filename, uint32_t start_addr) {
+    ap_uint<32>* words = ram.words();
+
     std::ifstream file(filename, std::ios::binary | std::ios::ate);
     if (!file) {
         std::cerr << "[ERROR] Could not open file: " << filename << std::endl;
@@ -50,17 +89,18 @@ bool load_binary_to_ram(const char* filename, uint32_t start_addr) {
         uint32_t word_idx = ram_start_idx + (i / 4);
         int byte_shift = (i % 4) * 8; // Little Endian (0, 8, 16, 24)
 
-        if (word_idx >= RAM_SIZE_WORDS) {
+        if (word_idx >= RAM_SIZE) {
             std::cerr << "[ERROR] File loading overflowed RAM!" << std::endl;
             return false;
         }
 
         // Read-Modify-Write the word
-        uint32_t current_word = (unsigned int)ram[word_idx];
+        uint32_t current_word = (unsigned int)words[word_idx];
         current_word &= ~(0xFF << byte_shift);             // Clear byte
         current_word |= ((uint8_t)buffer[i] << byte_shift); // Set byte
-        ram[word_idx] = current_word;
+        words[word_idx] = current_word;
     }
+    ram.mark_dirty(ram_start_idx, ((size_t)size + 3) / 4);
 
     std::cout << "[LOADER] Loaded " << filename << " to 0x" << std::hex << start_addr 
               << " (" << std::dec << size << " bytes)" << std::endl;
@@ -71,9 +111,10 @@ bool load_binary_to_ram(const char* filename, uint32_t start_addr) {
 // MAIN TESTBENCH
 // --------------------------------------------------------------------------
 int main() {
-    setvbuf(stdout, NULL, _IONBF, 0);
     // 1. PATHS
     CORE_DEBUG = false;
+    CORE_BLOCK_ENGINE = true; // Basic-block execution (C-Sim only)
+    CORE_JIT = true;          // x86-64 translation of hot blocks (falls back to the interpreter if unsupported)
     const char* KERNEL_PATH = "I:/Vitis_Files/Pipeline_Tests/Global_Core_Revised/Image";
     const char* DTB_PATH    = "I:/Vitis_Files/Pipeline_Tests/Global_Core_Revised/system.dtb";
     
@@ -81,40 +122,90 @@ int main() {
     std::cout << "      RISC-V LINUX BOOT SIMULATION                \n";
     std::cout << "--------------------------------------------------\n";
 
-    // 2. Clear RAM
-    for(int i=0; i<RAM_SIZE_WORDS; i++) ram[i] = 0;
+    if (!ram.ok()) return -1;
+    Hart hart = Hart();
+    hart_track_writes(hart, ram.dirty_map());
+
+    if (CHECKPOINT_LOAD[0]) {
+        // 2-5. Resume: RAM and core state come from the checkpoint
+        if (!checkpoint_load(CHECKPOINT_LOAD, hart, ram)) return -1;
+    } else {
+        // 2. Clear RAM (fresh reservation is already zero)
+
+        // 3. Load Files
+        // Kernel to start of RAM (0x80000000)
+        if (!load_binary_to_ram(KERNEL_PATH, 0x80000000)) return -1;
+        
+        // DTB to 8MB offset (0x80800000)
+        uint32_t dtb_load_addr = 0x80800000;
+        if (!load_binary_to_ram(DTB_PATH, dtb_load_addr)) return -1;
+
+        // 4. Configure Global Variables (Communication with Core)
+        ENTRY_PC = 0x80000000;    // Kernel Entry Point
+        DTB_ADDR = dtb_load_addr; // Device Tree Pointer
+        
+        // Check if DTB loaded correctly
+        uint32_t dtb_magic = (unsigned int)ram.words()[(0x80800000 - 0x80000000)/4];
+        // Swap bytes if needed (DTB is Big Endian, RAM is Little Endian usually)
+        // Just printing it is enough to see if it's non-zero.
+        std::cout << "[DEBUG] DTB First Word at 0x80800000: 0x" << std::hex << dtb_magic << std::endl;
+
+        std::cout << "[INIT] ENTRY_PC set to: 0x" << std::hex << ENTRY_PC << "\n";
+        std::cout << "[INIT] DTB_ADDR set to: 0x" << std::hex << DTB_ADDR << std::dec << "\n";
+
+        // 5. Initialize Core
+        hart_init(hart, (unsigned)ENTRY_PC);
+    }
 
-    // 3. Load Files
-    // Kernel to start of RAM (0x80000000)
-    if (!load_binary_to_ram(KERNEL_PATH, 0x80000000)) return -1;
-    
-    // DTB to 16MB offset (0x81000000)
-    uint32_t dtb_load_addr = 0x80800000;
-    if (!load_binary_to_ram(DTB_PATH, dtb_load_addr)) return -1;
+    if (ENABLE_PROFILER) hart_profile(hart, true);
 
-    // 4. Configure Global Variables (Communication with Core)
-    ENTRY_PC = 0x80000000;    // Kernel Entry Point
-    DTB_ADDR = dtb_load_addr; // Device Tree Pointer
-    
-    // Check if DTB loaded correctly
-    uint32_t dtb_magic = (unsigned int)ram[(0x80800000 - 0x80000000)/4];
-    // Swap bytes if needed (DTB is Big Endian, RAM is Little Endian usually)
-    // Just printing it is enough to see if it's non-zero.
-    std::cout << "[DEBUG] DTB First Word at 0x80800000: 0x" << std::hex << dtb_magic << std::endl;
+    CallTracer calls(CHROME_TRACE[0] ? 4000000 : 0);
+    if (ENABLE_CALLGRAPH) calls.attach(hart);
 
-    std::cout << "[INIT] ENTRY_PC set to: 0x" << std::hex << ENTRY_PC << "\n";
-    std::cout << "[INIT] DTB_ADDR set to: 0x" << std::hex << DTB_ADDR << "\n";
+    TraceWriter trace;
+    if (TRACE_FILE[0] && trace.open(TRACE_FILE)) trace.attach(hart);
 
-    // 5. Initialize Core
-    riscv_init(); 
+    LockstepChecker lockstep;
+    if (ENABLE_LOCKSTEP) lockstep.attach(hart, ram.bus());
 
     std::cout << "[RUN] Starting Execution loop..." << std::endl;
     
     // 6. Execution Loop
-    int step_count = 0;
     int core_cycles = 0; // Dummy variable to catch the cycle count output
 
-    riscv_step((volatile uint32_t*)ram, 10000000, &core_cycles);
+    hart_step(hart, ram.bus(), ram.bus(), RUN_CYCLES, &core_cycles);
+    std::cout << "\n[RUN] Stopped at cycle " << std::dec << core_cycles << " ("
+              << hart_idle_cycles(hart) << " idle cycles skipped at WFI)" << std::endl;
+    if (ENABLE_LOCKSTEP) {
+        bool same = lockstep.finish(hart);
+        std::cout << "[LOCKSTEP] " << std::dec << lockstep.checked() << " instructions "
+                  << (same ? "match the reference" : "checked before the divergence") << std::endl;
+    }
+    if (TRACE_FILE[0] && trace.close(hart)) {
+        std::cout << "[TRACE] " << std::dec << trace.records() << " instructions, " << trace.bytes()
+                  << " bytes written to " << TRACE_FILE << std::endl;
+    }
+
+    // 7. Profile Report
+    std::vector<ProfileSymbol> syms;
+    if ((ENABLE_PROFILER || ENABLE_CALLGRAPH) && PROFILE_SYMBOLS[0]) syms = profile_symbols_from_map(PROFILE_SYMBOLS);
+    if (ENABLE_PROFILER) {
+        std::vector<ProfileEntry> funcs = profile_collect(hart, syms);
+        profile_print(funcs, std::cout, 30);
+        if (PROFILE_FOLDED[0]) profile_write_folded(funcs, PROFILE_FOLDED);
+    }
+    if (ENABLE_CALLGRAPH) {
+        calls.finish(hart);
+        calls.symbols(syms);
+        calls.print_functions(std::cout, 30);
+        calls.print_tree(std::cout, 2.0);
+        if (CALLGRAPH_FOLDED[0]) calls.write_folded(CALLGRAPH_FOLDED);
+        if (CHROME_TRACE[0]) calls.write_chrome_trace(CHROME_TRACE, 100.0);
+    }
+
+    // 8. Save State
+    if (CHECKPOINT_SAVE[0] && !checkpoint_save(CHECKPOINT_SAVE, hart, ram)) return -1;
 
+    hart_free(hart);
     return 0;
-}
\ No newline at end of file
+}
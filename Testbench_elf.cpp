@@ -15,6 +15,12 @@
 #include "elf.h"
 #include "elfFile.h"
 #include "core.h"
+#include "profiler.h"
+#include "calltrace.h"
+#include "insn_trace.h"
+#include "ref_iss.h"
+#include "timing_model.h"
+#include "branch_pred.h"
 
 // ============================================================================
 //  USER CONFIGURATION SWITCHES
@@ -24,18 +30,49 @@
 #define INSTRUCTION_LIMIT 1000000 
 
 // 2. Debug Switches
-const bool ENABLE_CORE_DEBUG = false;
+const bool ENABLE_CORE_DEBUG = false; // Stage logs need a -DCORE_TRACE=1 build
+const bool ENABLE_BLOCK_ENGINE = true; // Basic-block execution (C-Sim only)
 const bool ENABLE_MEMORY_INSPECTION = false; 
 
+// 3. Profiler (C-Sim only): per-function cycles from the ELF symbol table
+const bool ENABLE_PROFILER = false;
+#define PROFILE_TOP    20                // Functions in the text report (0 = all)
+#define PROFILE_FOLDED "profile.folded"  // Collapsed stacks for flamegraph.pl ("" = off)
+
+// 4. Call Graph (C-Sim only): inclusive/exclusive cycles per call path
+const bool ENABLE_CALLGRAPH = false;
+#define CALLGRAPH_MIN_PCT 1.0                 // Hide subtrees below this share of all cycles
+#define CALLGRAPH_FOLDED  "callgraph.folded"  // Collapsed call paths ("" = off)
+#define CHROME_TRACE      ""                  // Timeline JSON for ui.perfetto.dev ("" = off)
+#define CHROME_TRACE_MHZ  100.0               // Core clock for the timeline timestamps
+
+// 5. Instruction Trace (C-Sim only): every retired instruction in a compact
+//    binary file (insn_trace.h); the fast alternative to CORE_TRACE logs
+#define TRACE_FILE ""                         // "" = off
+
+// 6. Lockstep Check (C-Sim only): compare every instruction against the
+//    reference ISS in ref_iss.h; stops at the first divergence
+const bool ENABLE_LOCKSTEP = false;
+
+// 7. Timing Model (C-Sim only): projected cycles and CPI of a hardware
+//    implementation (timing_model.h): 0 = off, 1 = this core (multi-cycle,
+//    caches off), 2 = 5-stage pipeline. Switches 5-8 share the retire
+//    hook; enable one at a time.
+#define TIMING_MODEL 0
+
+// 8. Branch Predictors (C-Sim only): misprediction rates of the predictors
+//    in predictor_set() (branch_pred.h) and the hardest branch PCs
+const bool ENABLE_BRANCH_EVAL = false;
+
+// 9. Core Variant: run the five-stage pipeline (hart_step_pipelined) instead
+//    of the one-instruction-at-a-time core; cycles are then pipeline steps
+const bool RUN_PIPELINED = false;
+
 // ============================================================================
 
 // UNIFIED RAM ARRAY
 ap_uint<32> ram[RAM_SIZE];
 
-extern void riscv_init();
-// UPDATED SIGNATURE
-extern void riscv_step(volatile uint32_t* ram, int cycles);
-
 int main(int argc, char* argv[])
 {
     const char* elf_filename = "rsort.riscv";
@@ -63,8 +100,29 @@ int main(int argc, char* argv[])
     std::cout << "\n[TESTBENCH] Initializing Core...\n";
     
     CORE_DEBUG = ENABLE_CORE_DEBUG; 
+    if (ENABLE_CORE_DEBUG && !CORE_TRACE) {
+        std::cout << "[TESTBENCH] WARNING: Core logging is compiled out, rebuild with -DCORE_TRACE=1\n";
+    }
+    CORE_BLOCK_ENGINE = ENABLE_BLOCK_ENGINE;
     
-    riscv_init();
+    Hart hart = Hart();
+    hart_init(hart, (unsigned)ENTRY_PC);
+    if (ENABLE_PROFILER) hart_profile(hart, true);
+
+    CallTracer calls(CHROME_TRACE[0] ? 1000000 : 0);
+    if (ENABLE_CALLGRAPH) calls.attach(hart);
+
+    TraceWriter trace;
+    if (TRACE_FILE[0] && trace.open(TRACE_FILE)) trace.attach(hart);
+
+    LockstepChecker lockstep;
+    if (ENABLE_LOCKSTEP) lockstep.attach(hart, (volatile uint32_t*)ram);
+
+    TimingModel timing(TIMING_MODEL == 1 ? timing_multicycle() : timing_pipeline5());
+    if (TIMING_MODEL) timing.attach(hart);
+
+    BranchEval branches;
+    if (ENABLE_BRANCH_EVAL) branches.attach(hart);
 
     std::cout << "\n[TESTBENCH] Starting Simulation (Max " << INSTRUCTION_LIMIT << " cycles)...\n";
     
@@ -72,7 +130,21 @@ int main(int argc, char* argv[])
 
     // Single Call to Hardware
     // The hardware will loop internally until it hits the ecall or the limit
-    riscv_step((volatile uint32_t*)ram, INSTRUCTION_LIMIT);
+    int cycles = 0;
+    if (RUN_PIPELINED) hart_step_pipelined(hart, (volatile uint32_t*)ram, (volatile uint32_t*)ram, INSTRUCTION_LIMIT, &cycles);
+    else               hart_step(hart, (volatile uint32_t*)ram, (volatile uint32_t*)ram, INSTRUCTION_LIMIT, &cycles);
+
+    if (ENABLE_LOCKSTEP && !lockstep.finish(hart)) {
+        std::cout << "[TESTBENCH] FAIL (Core diverged from the reference ISS)\n";
+        hart_free(hart);
+        return 1;
+    }
+    if (ENABLE_LOCKSTEP) std::cout << "[LOCKSTEP] " << std::dec << lockstep.checked() << " instructions match the reference\n";
+
+    if (TRACE_FILE[0] && trace.close(hart)) {
+        std::cout << "[TRACE] " << std::dec << trace.records() << " instructions, " << trace.bytes()
+                  << " bytes written to " << TRACE_FILE << "\n";
+    }
 
     // Check results after hardware returns
     uint32_t tohost = ram[tohost_idx];
@@ -92,6 +164,43 @@ int main(int argc, char* argv[])
         passed = false;
     }
 
+    if (TIMING_MODEL) {
+        timing.finish(hart);
+        timing.print(std::cout);
+    }
+    if (ENABLE_BRANCH_EVAL) {
+        branches.finish(hart);
+        branches.print(std::cout);
+        branches.print_branches(std::cout, PROFILE_TOP, profile_symbols_from_elf(loader));
+    }
+
+    // ================================================================
+    // PROFILE REPORT
+    // ================================================================
+    if (ENABLE_PROFILER) {
+        std::vector<ProfileEntry> funcs = profile_collect(hart, profile_symbols_from_elf(loader));
+        profile_print(funcs, std::cout, PROFILE_TOP);
+        if (PROFILE_FOLDED[0] && profile_write_folded(funcs, PROFILE_FOLDED)) {
+            std::cout << "[PROF] Collapsed stacks written to " << PROFILE_FOLDED << "\n";
+        }
+    }
+
+    // ================================================================
+    // CALL GRAPH
+    // ================================================================
+    if (ENABLE_CALLGRAPH) {
+        calls.finish(hart);
+        calls.symbols(profile_symbols_from_elf(loader));
+        calls.print_functions(std::cout, PROFILE_TOP);
+        calls.print_tree(std::cout, CALLGRAPH_MIN_PCT);
+        if (CALLGRAPH_FOLDED[0] && calls.write_folded(CALLGRAPH_FOLDED)) {
+            std::cout << "[CALL] Collapsed call paths written to " << CALLGRAPH_FOLDED << "\n";
+        }
+        if (CHROME_TRACE[0] && calls.write_chrome_trace(CHROME_TRACE, CHROME_TRACE_MHZ)) {
+            std::cout << "[CALL] Timeline written to " << CHROME_TRACE << "\n";
+        }
+    }
+
     // ================================================================
     // MEMORY INSPECTION (Using Configuration Switch)
     // Note: data_addr is specific to 'rsort.riscv'. Update for other files (This is disabled by default).
@@ -120,5 +229,6 @@ int main(int argc, char* argv[])
         }
     }
 
+    hart_free(hart);
     return passed ? 0 : 1;
 }
\ No newline at end of file
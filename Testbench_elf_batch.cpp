@@ -7,6 +7,10 @@
 #include <vector>
 #include <string>
 #include <algorithm>
+#include <filesystem> // C++17: portable directory scanning
+#include <thread>
+#include <atomic>
+#include <chrono>
 
 // --- Vitis HLS Headers ---
 #include <ap_int.h>
@@ -15,127 +19,378 @@
 #include "elf.h"
 #include "elfFile.h"
 #include "core.h"
+#include "guest_memory.h"
+#include "ref_iss.h"
+#include "timing_model.h"
+#include "cache_sim.h"
+#include "branch_pred.h"
 
-// --- OS Specific Headers (Batch Runner Only) ---
-#include <windows.h> // Required for directory scanning (FindFirstFile)
+namespace fs = std::filesystem;
 
 // ============================================================================
 //  USER CONFIGURATION SWITCHES
 // ============================================================================
 
 // 1. Execution Limit (Prevent infinite loops)
-//    Increased to accommodate larger benchmarks if needed
-#define TEST_TIMEOUT   5000000 
+//    Increased to accommodate larger benchmarks if needed. The five-stage
+//    pipeline (switch 8) counts clocks at a CPI of up to ~1.5, so it gets
+//    twice the budget.
+#define TEST_TIMEOUT   (PIPELINED_CORE ? 2 * 5000000 : 5000000)
 
-// 2. Debug Switch
-const bool ENABLE_CORE_DEBUG = false;
+// 2. Parallelism (0 = one worker per hardware thread)
+//    Each worker owns a sparse guest RAM; only pages a test touches use memory.
+#define NUM_WORKERS    0
+
+// 3. Repeat Runs (>1 = rerun each test from a post-load snapshot and
+//    require identical results; catches state leaking between runs)
+#define RUNS_PER_TEST  1
+
+// 4. Lockstep Check (1 = compare every instruction against the reference
+//    ISS in ref_iss.h; a divergence fails the test)
+#define LOCKSTEP_CHECK 0
+
+// 5. Timing Model (1 = project cycles and CPI of each test on this core and
+//    on a 5-stage pipeline, see timing_model.h; not with LOCKSTEP_CHECK)
+#define TIMING_REPORT  0
+
+// 6. Cache Sweep (1 = simulate every I-/D-cache configuration of
+//    sweep_icaches() / sweep_dcaches() below on each test's fetch and data
+//    streams, and report suite-wide hit rates and AXI transactions saved;
+//    see cache_sim.h; not with LOCKSTEP_CHECK)
+#define CACHE_SWEEP    0
+
+// 7. Branch Predictors (1 = misprediction rates of every predictor in
+//    predictor_set() per test and over the suite, see branch_pred.h;
+//    not with LOCKSTEP_CHECK)
+#define BRANCH_EVAL    0
+
+// 8. Core Variant (1 = run every test on the five-stage pipeline,
+//    hart_step_pipelined; cycles are then pipeline steps)
+#define PIPELINED_CORE 0
+
+// 9. Debug Switch
+const bool ENABLE_CORE_DEBUG = false; // Stage logs need a -DCORE_TRACE=1 build
+const bool ENABLE_BLOCK_ENGINE = true; // Basic-block execution (C-Sim only)
 
 // ============================================================================
 
-// UNIFIED RAM ARRAY
-ap_uint<32> ram[RAM_SIZE]; 
+// Cache configurations for CACHE_SWEEP
+static std::vector<CacheConfig> sweep_icaches() {
+    return cache_config_grid({1024, 2048, 4096, 8192, 16384}, {1, 2, 4}, {16, 32, 64}, false, CACHE_LRU);
+}
+static std::vector<CacheConfig> sweep_dcaches() {
+    std::vector<CacheConfig> c = cache_config_grid({1024, 2048, 4096, 8192, 16384}, {1, 2, 4}, {16, 32, 64}, true, CACHE_LRU);
+    std::vector<CacheConfig> wt = cache_config_grid({4096, 16384}, {2}, {32}, false, CACHE_LRU);
+    c.insert(c.end(), wt.begin(), wt.end());
+    return c;
+}
+
+enum TestStatus { RESULT_PASS, RESULT_FAIL, RESULT_TIMEOUT };
+
+struct TestResult {
+    std::string name;
+    TestStatus  status;
+    int         exit_code;
+    int         cycles;
+    double      seconds;
+    uint64_t    insns;     // TIMING_REPORT: instructions modelled
+    uint64_t    projected[2]; // TIMING_REPORT: multi-cycle, pipelined cycles
+    std::vector<CacheStats> icache, dcache; // CACHE_SWEEP, per configuration
+    std::vector<PredictorStats> predictors; // BRANCH_EVAL, per predictor
+    uint64_t    branch_insns;
+};
+
+// TIMING_REPORT, CACHE_SWEEP and BRANCH_EVAL share the single retire hook
+struct RetireTaps {
+    TimingModel* timing; // Both presets, or null
+    CacheSweep*  caches;
+    BranchEval*  branches;
+};
 
-extern void riscv_init();
-// UPDATED SIGNATURE: Accepts cycle count
-extern void riscv_step(volatile uint32_t* ram, int cycles); 
+static void tap_retire(void* ctx, const HartRetire& r) {
+    RetireTaps& t = *(RetireTaps*)ctx;
+    if (t.timing) {
+        t.timing[0].retire(r);
+        t.timing[1].retire(r);
+    }
+    if (t.caches) t.caches->retire(r);
+    if (t.branches) t.branches->retire(r);
+}
 
 // ============================================================================
-// Directory Scanner (Windows)
+// Test Discovery (std::filesystem)
 // ============================================================================
-std::vector<std::string> get_test_files(std::string folder) {
+static bool is_elf(const fs::path& p) {
+    std::ifstream f(p, std::ios::binary);
+    unsigned char magic[4] = {0, 0, 0, 0};
+    f.read(reinterpret_cast<char*>(magic), 4);
+    return f && std::equal(std::begin(ELF_MAGIC), std::end(ELF_MAGIC), magic);
+}
+
+// A directory contributes its ELF files (no recursion); a file is taken as is
+std::vector<std::string> get_test_files(const std::string& path) {
     std::vector<std::string> files;
-    std::string search_path = folder + "/*";
-    WIN32_FIND_DATA fd;
-    HANDLE hFind = ::FindFirstFile(search_path.c_str(), &fd);
-    
-    if (hFind != INVALID_HANDLE_VALUE) {
-        do {
-            if (!(fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
-                std::string filename = fd.cFileName;
-                // Filter: Ignore .dump files, hidden files, and non-elf files
-                if (filename.find(".dump") == std::string::npos && filename.find(".") != 0) {
-                    files.push_back(filename);
-                }
-            }
-        } while (::FindNextFile(hFind, &fd));
-        ::FindClose(hFind);
+    std::error_code ec;
+
+    if (fs::is_regular_file(path, ec)) {
+        files.push_back(path);
+        return files;
     }
+
+    for (const auto& entry : fs::directory_iterator(path, ec)) {
+        if (!entry.is_regular_file(ec)) continue;
+        std::string filename = entry.path().filename().string();
+        // Filter: Ignore .dump files, hidden files, and non-elf files
+        if (filename.find(".dump") != std::string::npos || filename.find(".") == 0) continue;
+        if (!is_elf(entry.path())) continue;
+        files.push_back(entry.path().string());
+    }
+    std::sort(files.begin(), files.end());
     return files;
 }
 
+// ============================================================================
+// Single Test (runs on a worker thread, own Hart + own RAM)
+// ============================================================================
+// 'hart' is the worker's: hart_init resets it but keeps its C-sim caches, so
+// no test pays for allocating and clearing a fresh set.
+TestResult run_test(const std::string& path, GuestMemory& mem, Hart& hart) {
+    TestResult r;
+    r.name      = path;
+    r.status    = RESULT_TIMEOUT;
+    r.exit_code = 0;
+    r.cycles    = 0;
+    r.insns     = 0;
+    r.projected[0] = r.projected[1] = 0;
+    r.branch_insns = 0;
+
+    auto t0 = std::chrono::steady_clock::now();
+
+    // 1. Clear Memory (only the pages the previous test wrote)
+    mem.reset();
+
+    // 2. Load ELF (Using shared class from elfFile.h)
+    ElfFile loader(path.c_str());
+    uword_t entry_pc = mem.load_elf(loader);
+
+    // 3. Dynamic Tohost Calculation
+    unsigned tohost_idx = 0;
+    if (loader.tohost_addr_found != 0) {
+        tohost_idx = (loader.tohost_addr_found - DRAM_BASE) >> 2;
+    } else {
+        tohost_idx = (0x80001000 - DRAM_BASE) >> 2;
+    }
+
+    // 4. Init Core
+    hart_init(hart, entry_pc);
+    hart_track_writes(hart, mem.dirty_map());
+
+    GuestSnapshot start;
+    if (RUNS_PER_TEST > 1) mem.snapshot(hart, start);
+
+    for (int run = 0; run < RUNS_PER_TEST; run++) {
+        // Later runs: undo only the pages the previous run wrote
+        if (run > 0) mem.restore(hart, start);
+
+        // 5. Run Simulation
+        LockstepChecker lockstep;
+        if (LOCKSTEP_CHECK) lockstep.attach(hart, mem.bus());
+
+        TimingModel timing[2] = { TimingModel(timing_multicycle()), TimingModel(timing_pipeline5()) };
+        CacheSweep  caches(CACHE_SWEEP ? sweep_icaches() : std::vector<CacheConfig>(),
+                           CACHE_SWEEP ? sweep_dcaches() : std::vector<CacheConfig>());
+        BranchEval  branches(BRANCH_EVAL ? predictor_set() : std::vector<PredictorConfig>());
+        RetireTaps  taps;
+        taps.timing   = TIMING_REPORT ? timing : 0;
+        taps.caches   = CACHE_SWEEP ? &caches : 0;
+        taps.branches = BRANCH_EVAL ? &branches : 0;
+        if (taps.timing || taps.caches || taps.branches) hart_retire_hook(hart, tap_retire, &taps);
+
+        int cycles = 0;
+        if (PIPELINED_CORE) hart_step_pipelined(hart, mem.bus(), mem.bus(), TEST_TIMEOUT, &cycles);
+        else                hart_step(hart, mem.bus(), mem.bus(), TEST_TIMEOUT, &cycles);
+
+        // 6. Verdict: HTIF tohost first, then the exit ECALL (a7 = 93, a0 = code)
+        TestStatus status = RESULT_TIMEOUT;
+        int exit_code = 0;
+        uint32_t tohost = mem.bus()[tohost_idx];
+        if (tohost & 1) {
+            exit_code = tohost >> 1;
+            status    = (exit_code == 0) ? RESULT_PASS : RESULT_FAIL;
+        } else if (hart.is_finished) {
+            exit_code = (int)hart.regfile[10];
+            status    = (exit_code == 0) ? RESULT_PASS : RESULT_FAIL;
+        }
+        if (LOCKSTEP_CHECK && !lockstep.finish(hart)) {
+            std::cout << "[BATCH] " << path << ": diverged from the reference ISS\n";
+            status = RESULT_FAIL;
+        }
+        if (taps.timing || taps.caches || taps.branches) {
+            hart_retire_hook(hart, 0, 0);
+            timing[0].flush();
+            timing[1].flush();
+            caches.flush();
+        }
+
+        if (run == 0) {
+            r.status    = status;
+            r.exit_code = exit_code;
+            r.cycles    = cycles;
+            r.insns     = timing[0].instructions();
+            r.projected[0] = timing[0].cycles();
+            r.projected[1] = timing[1].cycles();
+            for (const auto& c : caches.icaches()) r.icache.push_back(c.stats());
+            for (const auto& c : caches.dcaches()) r.dcache.push_back(c.stats());
+            for (const auto& p : branches.predictors()) r.predictors.push_back(p.stats());
+            r.branch_insns = branches.instructions();
+        } else if (status != r.status || exit_code != r.exit_code || cycles != r.cycles) {
+            std::cout << "[BATCH] " << path << ": run " << run << " differs from run 0\n";
+            r.status = RESULT_FAIL;
+        }
+    }
+
+    r.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    return r;
+}
+
 // ============================================================================
 // Main Batch Loop
 // ============================================================================
 int main(int argc, char* argv[])
 {
-    std::string folder_path = "";
-    if (argc > 1) folder_path = argv[1];
-    else {
-        std::cout << "Usage: <executable> <path_to_test_folder>\n";
+    if (argc < 2) {
+        std::cout << "Usage: <executable> <test_folder_or_elf> [more folders/elfs...]\n";
         return 1;
     }
 
-    std::vector<std::string> tests = get_test_files(folder_path);
-    std::cout << "[BATCH] Found " << tests.size() << " potential tests in " << folder_path << "\n";
-    
+    std::vector<std::string> tests;
+    for (int i = 1; i < argc; i++) {
+        std::vector<std::string> found = get_test_files(argv[i]);
+        std::cout << "[BATCH] Found " << found.size() << " tests in " << argv[i] << "\n";
+        tests.insert(tests.end(), found.begin(), found.end());
+    }
     if (tests.empty()) return 1;
 
-    int total_pass = 0;
-    int total_fail = 0;
-    
+    unsigned workers = NUM_WORKERS ? NUM_WORKERS : std::thread::hardware_concurrency();
+    if (workers == 0) workers = 1;
+    if (workers > tests.size()) workers = (unsigned)tests.size();
+
+    CORE_DEBUG = ENABLE_CORE_DEBUG; // Keep logs clean
+    CORE_BLOCK_ENGINE = ENABLE_BLOCK_ENGINE;
+
     std::cout << "\n==================================================================\n";
-    std::cout << "  RISC-V REGRESSION RUNNER (BATCH MODE) \n";
+    std::cout << "  RISC-V REGRESSION RUNNER (BATCH MODE, " << workers << " workers) \n";
     std::cout << "==================================================================\n";
 
-    for (const auto& test_name : tests) {
-        std::string full_path = folder_path + "/" + test_name;
-        
-        // 1. Clear Memory
-        memset(ram, 0, sizeof(ram));
+    // Thread pool: each worker pulls the next test index until none are left
+    std::vector<TestResult> results(tests.size());
+    std::atomic<size_t> next_test(0);
+    auto t0 = std::chrono::steady_clock::now();
 
-        // 2. Load ELF (Using shared class from elfFile.h)
-        ElfFile loader(full_path.c_str());
-        ENTRY_PC = loader.load_to_mem(ram, RAM_SIZE);
-
-        if (ENTRY_PC == 0) continue; // Skip invalid files
+    std::vector<std::thread> pool;
+    for (unsigned w = 0; w < workers; w++) {
+        pool.emplace_back([&]() {
+            GuestMemory mem;
+            Hart hart = Hart();
+            size_t i;
+            while ((i = next_test++) < tests.size()) {
+                results[i] = run_test(tests[i], mem, hart);
+            }
+            hart_free(hart);
+        });
+    }
+    for (auto& t : pool) t.join();
 
-        // 3. Dynamic Tohost Calculation
-        unsigned tohost_idx = 0;
-        if (loader.tohost_addr_found != 0) {
-            tohost_idx = (loader.tohost_addr_found - DRAM_BASE) >> 2;
-        } else {
-            tohost_idx = (0x80001000 - DRAM_BASE) >> 2;
-        }
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
 
-        // 4. Init Core
-        CORE_DEBUG = ENABLE_CORE_DEBUG; // Keep logs clean
-        riscv_init();
+    // Report in discovery order (the core's own prints may interleave above)
+    int total_pass = 0;
+    int total_fail = 0;
+    int total_timeout = 0;
+    long long total_cycles = 0;
+    uint64_t  total_insns = 0, total_projected[2] = {0, 0};
 
-        // 5. Run Simulation
-        // Single Call to Hardware per test file (matching Hardcoded logic)
-        riscv_step((volatile uint32_t*)ram, TEST_TIMEOUT);
-            
-        // 6. Check Host Interface after simulation
-        uint32_t tohost = ram[tohost_idx];
-            
-        if (tohost & 1) {
-            int exit_code = tohost >> 1;
-            if (exit_code == 0) {
-                std::cout << std::left << std::setw(30) << test_name << " : PASS\n";
-                total_pass++;
-            } else {
-                std::cout << std::left << std::setw(30) << test_name << " : FAIL (Code: " << exit_code << ")\n";
-                total_fail++;
-            }
-        } else {
-            std::cout << std::left << std::setw(30) << test_name << " : TIMEOUT\n";
-            total_fail++;
+    std::cout << "\n";
+    if (TIMING_REPORT) {
+        std::cout << std::right << std::setw(79) << "multi-cycle" << std::setw(23) << "5-stage" << "\n";
+    }
+    for (const auto& r : results) {
+        std::string name = fs::path(r.name).filename().string();
+        std::cout << std::left << std::setw(30) << name << std::dec;
+        switch (r.status) {
+            case RESULT_PASS:    std::cout << " : PASS   "; total_pass++; break;
+            case RESULT_FAIL:    std::cout << " : FAIL   "; total_fail++; break;
+            case RESULT_TIMEOUT: std::cout << " : TIMEOUT"; total_timeout++; break;
+        }
+        std::cout << std::right << std::setw(10) << r.cycles << " cycles"
+                  << std::fixed << std::setprecision(2) << std::setw(8) << r.seconds << " s";
+        if (TIMING_REPORT && r.insns) {
+            std::cout << std::setw(12) << r.projected[0] << " (CPI " << std::setw(5)
+                      << (double)r.projected[0] / (double)r.insns << ")" << std::setw(11) << r.projected[1]
+                      << " (CPI " << (double)r.projected[1] / (double)r.insns << ")";
         }
+        if (r.status == RESULT_FAIL) std::cout << " (Code: " << r.exit_code << ")";
+        std::cout << "\n";
+        total_cycles += r.cycles;
+        total_insns  += r.insns;
+        total_projected[0] += r.projected[0];
+        total_projected[1] += r.projected[1];
     }
 
     std::cout << "\n==================================================================\n";
-    std::cout << "SUMMARY: " << total_pass << " PASSED, " << total_fail << " FAILED\n";
+    std::cout << "SUMMARY: " << total_pass << " PASSED, " << total_fail << " FAILED, "
+              << total_timeout << " TIMEOUT (" << tests.size() << " tests, "
+              << total_cycles << " cycles, " << std::fixed << std::setprecision(2) << wall << " s)\n";
+    if (TIMING_REPORT && total_insns) {
+        std::cout << "PROJECTED: multi-cycle " << total_projected[0] << " cycles (CPI "
+                  << (double)total_projected[0] / (double)total_insns << "), 5-stage pipeline "
+                  << total_projected[1] << " cycles (CPI " << (double)total_projected[1] / (double)total_insns << ")\n";
+    }
     std::cout << "==================================================================\n";
 
-    return 0;
-}
\ No newline at end of file
+    if (CACHE_SWEEP) {
+        std::vector<CacheConfig> icfg = sweep_icaches(), dcfg = sweep_dcaches();
+        std::vector<CacheStats>  isum(icfg.size()), dsum(dcfg.size());
+        for (auto& s : isum) memset(&s, 0, sizeof(s));
+        for (auto& s : dsum) memset(&s, 0, sizeof(s));
+        for (const auto& r : results) {
+            for (size_t i = 0; i < r.icache.size() && i < isum.size(); i++) isum[i].add(r.icache[i]);
+            for (size_t i = 0; i < r.dcache.size() && i < dsum.size(); i++) dsum[i].add(r.dcache[i]);
+        }
+        cache_print(std::cout, "I-CACHE SWEEP (all tests)", icfg, isum);
+        cache_print(std::cout, "D-CACHE SWEEP (all tests)", dcfg, dsum);
+    }
+
+    if (BRANCH_EVAL) {
+        // Conditional-branch misprediction rate per test and predictor
+        std::vector<PredictorConfig> pcfg = predictor_set();
+        std::vector<PredictorStats>  psum(pcfg.size());
+        for (auto& p : psum) memset(&p, 0, sizeof(p));
+        uint64_t insns = 0;
+
+        std::cout << "\n==================================================================\n";
+        std::cout << "  BRANCH PREDICTION (conditional branch miss %)\n";
+        for (size_t i = 0; i < pcfg.size(); i++) std::cout << "    #" << i + 1 << " " << predictor_name(pcfg[i]) << "\n";
+        std::cout << "==================================================================\n";
+        std::cout << std::left << std::setw(30) << "test" << std::right;
+        for (size_t i = 0; i < pcfg.size(); i++) std::cout << std::setw(8) << ("#" + std::to_string(i + 1));
+        std::cout << "\n" << std::fixed << std::setprecision(2);
+        for (const auto& r : results) {
+            std::cout << std::left << std::setw(30) << fs::path(r.name).filename().string() << std::right;
+            for (size_t i = 0; i < r.predictors.size() && i < psum.size(); i++) {
+                const PredictorStats& p = r.predictors[i];
+                std::cout << std::setw(8) << (p.branches ? 100.0 * (double)p.branch_miss / (double)p.branches : 0.0);
+                psum[i].add(p);
+            }
+            std::cout << "\n";
+            insns += r.branch_insns;
+        }
+        std::cout << std::left << std::setw(30) << "all tests" << std::right;
+        for (const auto& p : psum) std::cout << std::setw(8) << (p.branches ? 100.0 * (double)p.branch_miss / (double)p.branches : 0.0);
+        std::cout << "\n" << std::left << std::setw(30) << "all tests, MPKI (all jumps)" << std::right;
+        for (const auto& p : psum) std::cout << std::setw(8) << (insns ? 1000.0 * (double)p.misses() / (double)insns : 0.0);
+        std::cout << "\n";
+    }
+
+    return (total_fail + total_timeout) ? 1 : 0;
+}
@@ -0,0 +1,386 @@
+#ifndef BRANCH_PRED_H
+#define BRANCH_PRED_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include "core.h"
+#include "profiler.h"
+
+// =======================================================
+// Branch Predictor Evaluation (C-Sim Only)
+// =======================================================
+// Replays the control transfers of a run through candidate predictors for a
+// pipelined version of the core. Outcomes come from the retire hook: a
+// conditional branch was taken if the next retired pc is its target, and a
+// JALR went wherever the next pc is. Each predictor guesses the next pc the
+// way a decode-stage predictor would (the instruction and its static
+// target are known; register values are not):
+//
+//   branch   direction from the configured scheme (BTFN, bimodal, gshare)
+//   JAL      always right (pc-relative)
+//   return   JALR through x1/x5 (the ISA's link-register hints): the
+//            return-address stack if there is one, else the BTB
+//   JALR     other indirect jumps: the BTB's last target, if there is one
+//
+// With a BTB, 'btb_miss' also counts taken transfers whose target was not
+// in the BTB, i.e. the fetch bubbles a decode-time redirect would cost.
+
+enum PredScheme { PRED_BTFN, PRED_BIMODAL, PRED_GSHARE };
+
+struct PredictorConfig {
+    PredScheme scheme;
+    unsigned   table_bits;   // log2 of the 2-bit counter table (bimodal, gshare)
+    unsigned   history_bits; // Global history length (gshare)
+    unsigned   btb_entries;  // Direct-mapped BTB, 0 = none (power of two)
+    unsigned   ras_depth;    // Return-address stack, 0 = none
+};
+
+struct PredictorStats {
+    uint64_t branches, branch_miss;
+    uint64_t jumps, jump_miss;     // JALR other than returns
+    uint64_t returns, return_miss;
+    uint64_t taken;                // Taken transfers (branches, JAL, JALR)
+    uint64_t btb_miss;
+
+    uint64_t misses() const { return branch_miss + jump_miss + return_miss; }
+    void     add(const PredictorStats& o);
+};
+
+// "gshare 4K h12 btb64 ras8"
+std::string predictor_name(const PredictorConfig& c);
+
+// BTFN, bimodal, gshare, and gshare with a BTB and return-address stack
+std::vector<PredictorConfig> predictor_set();
+
+class BranchPredictor {
+public:
+    explicit BranchPredictor(const PredictorConfig& cfg);
+
+    // Predicts the next pc of the control transfer 'instr' at 'pc', then
+    // trains on 'next'. True if the prediction was right.
+    bool     step(uint32_t pc, uint32_t instr, uint32_t next);
+    void     reset();
+
+    const PredictorConfig& config() const { return cfg; }
+    const PredictorStats&  stats() const  { return st; }
+
+private:
+    PredictorConfig       cfg;
+    PredictorStats        st;
+    std::vector<uint8_t>  counters; // 2-bit saturating
+    uint32_t              history;
+    std::vector<uint32_t> btb_pc;
+    std::vector<uint32_t> btb_target;
+    std::vector<uint32_t> ras;
+    unsigned              ras_top;  // Next free slot (circular)
+    unsigned              ras_size;
+
+    bool     btb_lookup(uint32_t pc, uint32_t& target) const;
+    void     btb_update(uint32_t pc, uint32_t target);
+};
+
+// Every predictor of a set on one run, plus per-branch-PC outcomes
+class BranchEval {
+public:
+    explicit BranchEval(const std::vector<PredictorConfig>& cfgs = predictor_set());
+
+    // Feeds every instruction 'h' retires from now on
+    void     attach(Hart& h);
+    // Detaches from 'h'
+    void     finish(Hart& h);
+
+    // Feeds one retired instruction (for callers with their own hook)
+    void     retire(const HartRetire& r);
+
+    const std::vector<BranchPredictor>& predictors() const { return preds; }
+    uint64_t instructions() const { return insns; }
+
+    // Per predictor (numbered #1..): misprediction rates and MPKI
+    void     print(std::ostream& os) const;
+    // The 'top' conditional branches with the most mispredictions (summed
+    // over all predictors), with misses per predictor and symbol names
+    void     print_branches(std::ostream& os, unsigned top, std::vector<ProfileSymbol> syms) const;
+
+    static bool is_control(uint32_t instr);
+
+private:
+    struct Site {
+        uint64_t              execs;
+        uint64_t              taken;
+        std::vector<uint32_t> miss; // Per predictor
+    };
+
+    std::vector<BranchPredictor>           preds;
+    std::unordered_map<uint32_t, Site>     sites; // Conditional branches by pc
+    HartRetire                             prev;
+    bool                                   pending;
+    uint64_t                               insns;
+
+    static void on_retire(void* ctx, const HartRetire& r);
+    void        resolve(uint32_t pc, uint32_t instr, uint32_t next);
+};
+
+// --- Implementations ---
+
+inline void PredictorStats::add(const PredictorStats& o) {
+    branches    += o.branches;
+    branch_miss += o.branch_miss;
+    jumps       += o.jumps;
+    jump_miss   += o.jump_miss;
+    returns     += o.returns;
+    return_miss += o.return_miss;
+    taken       += o.taken;
+    btb_miss    += o.btb_miss;
+}
+
+inline std::string predictor_name(const PredictorConfig& c) {
+    static const char* scheme[] = {"btfn", "bimodal", "gshare"};
+    char buf[96];
+    int n = snprintf(buf, sizeof(buf), "%s", scheme[c.scheme]);
+    if (c.scheme != PRED_BTFN) {
+        unsigned entries = 1u << c.table_bits;
+        if (entries >= 1024) n += snprintf(buf + n, sizeof(buf) - n, " %uK", entries / 1024);
+        else                 n += snprintf(buf + n, sizeof(buf) - n, " %u", entries);
+    }
+    if (c.scheme == PRED_GSHARE) n += snprintf(buf + n, sizeof(buf) - n, " h%u", c.history_bits);
+    if (c.btb_entries)           n += snprintf(buf + n, sizeof(buf) - n, " btb%u", c.btb_entries);
+    if (c.ras_depth)             n += snprintf(buf + n, sizeof(buf) - n, " ras%u", c.ras_depth);
+    return buf;
+}
+
+inline std::vector<PredictorConfig> predictor_set() {
+    //                      scheme        table history  btb  ras
+    PredictorConfig set[] = {{PRED_BTFN,     0,    0,     0,   0},
+                             {PRED_BIMODAL, 10,    0,     0,   0},
+                             {PRED_GSHARE,  10,   10,     0,   0},
+                             {PRED_GSHARE,  12,   12,     0,   0},
+                             {PRED_BIMODAL, 10,    0,    64,   8},
+                             {PRED_GSHARE,  12,   12,    64,   8}};
+    return std::vector<PredictorConfig>(set, set + sizeof(set) / sizeof(set[0]));
+}
+
+inline BranchPredictor::BranchPredictor(const PredictorConfig& c) : cfg(c) {
+    if (cfg.scheme != PRED_BTFN) counters.resize((size_t)1 << cfg.table_bits);
+    btb_pc.resize(cfg.btb_entries);
+    btb_target.resize(cfg.btb_entries);
+    ras.resize(cfg.ras_depth);
+    reset();
+}
+
+inline void BranchPredictor::reset() {
+    memset(&st, 0, sizeof(st));
+    std::fill(counters.begin(), counters.end(), 1); // Weakly not taken
+    std::fill(btb_pc.begin(), btb_pc.end(), 1);     // Never a valid pc
+    history  = 0;
+    ras_top  = 0;
+    ras_size = 0;
+}
+
+inline bool BranchPredictor::btb_lookup(uint32_t pc, uint32_t& target) const {
+    if (!cfg.btb_entries) return false;
+    unsigned i = (pc >> 2) & (cfg.btb_entries - 1);
+    if (btb_pc[i] != pc) return false;
+    target = btb_target[i];
+    return true;
+}
+
+inline void BranchPredictor::btb_update(uint32_t pc, uint32_t target) {
+    if (!cfg.btb_entries) return;
+    unsigned i = (pc >> 2) & (cfg.btb_entries - 1);
+    btb_pc[i]     = pc;
+    btb_target[i] = target;
+}
+
+inline bool BranchPredictor::step(uint32_t pc, uint32_t instr, uint32_t next) {
+    unsigned opcode = instr & 0x7F;
+    unsigned rd     = (instr >> 7) & 31;
+    unsigned rs1    = (instr >> 15) & 31;
+    bool     taken  = next != pc + 4;
+    uint32_t predicted;
+
+    if (opcode == 0x63) {
+        int32_t  imm    = (int32_t)(((instr >> 31) & 1) << 12 | ((instr >> 7) & 1) << 11 |
+                                    ((instr >> 25) & 0x3F) << 5 | ((instr >> 8) & 0xF) << 1);
+        imm             = (imm << 19) >> 19;
+        uint32_t target = pc + (uint32_t)imm;
+        taken           = next == target;
+
+        bool guess;
+        unsigned idx = 0;
+        if (cfg.scheme == PRED_BTFN) {
+            guess = imm < 0;
+        } else {
+            uint32_t mask = (1u << cfg.table_bits) - 1;
+            idx   = (pc >> 2) & mask;
+            if (cfg.scheme == PRED_GSHARE) idx ^= history & mask;
+            guess = counters[idx] >= 2;
+        }
+        predicted = guess ? target : pc + 4;
+
+        if (cfg.scheme != PRED_BTFN) {
+            if (taken && counters[idx] < 3)  counters[idx]++;
+            if (!taken && counters[idx] > 0) counters[idx]--;
+        }
+        if (cfg.scheme == PRED_GSHARE) {
+            history = ((history << 1) | (taken ? 1 : 0)) & ((1u << cfg.history_bits) - 1);
+        }
+        st.branches++;
+        if (predicted != next) st.branch_miss++;
+    } else if (opcode == 0x6F) {
+        predicted = next; // JAL
+    } else {
+        // JALR: link-register hints, as the core's call hook uses them
+        bool link_rd  = rd == 1 || rd == 5;
+        bool link_rs1 = rs1 == 1 || rs1 == 5;
+        bool is_ret   = link_rs1 && (!link_rd || rd != rs1);
+
+        uint32_t btb_target_pc = 0;
+        bool     btb_hit       = btb_lookup(pc, btb_target_pc);
+        if (is_ret && cfg.ras_depth) {
+            predicted = ras_size ? ras[(ras_top + cfg.ras_depth - 1) % cfg.ras_depth] : pc + 4;
+            if (ras_size) {
+                ras_top = (ras_top + cfg.ras_depth - 1) % cfg.ras_depth;
+                ras_size--;
+            }
+        } else {
+            predicted = btb_hit ? btb_target_pc : pc + 4;
+        }
+        if (is_ret) {
+            st.returns++;
+            if (predicted != next) st.return_miss++;
+        } else {
+            st.jumps++;
+            if (predicted != next) st.jump_miss++;
+        }
+    }
+
+    // Calls push the return address (JAL and JALR writing x1/x5)
+    if ((opcode == 0x6F || opcode == 0x67) && (rd == 1 || rd == 5) && cfg.ras_depth) {
+        ras[ras_top] = pc + 4;
+        ras_top = (ras_top + 1) % cfg.ras_depth;
+        if (ras_size < cfg.ras_depth) ras_size++;
+    }
+
+    if (taken) {
+        st.taken++;
+        uint32_t t;
+        if (cfg.btb_entries && !(btb_lookup(pc, t) && t == next)) st.btb_miss++;
+        btb_update(pc, next);
+    }
+    return predicted == next;
+}
+
+inline BranchEval::BranchEval(const std::vector<PredictorConfig>& cfgs) : pending(false), insns(0) {
+    for (const auto& c : cfgs) preds.push_back(BranchPredictor(c));
+    memset(&prev, 0, sizeof(prev));
+}
+
+inline void BranchEval::attach(Hart& h) {
+    hart_retire_hook(h, on_retire, this);
+}
+
+inline void BranchEval::finish(Hart& h) {
+    hart_retire_hook(h, 0, 0);
+    pending = false; // The last transfer has no known outcome
+}
+
+inline void BranchEval::on_retire(void* ctx, const HartRetire& r) {
+    ((BranchEval*)ctx)->retire(r);
+}
+
+inline bool BranchEval::is_control(uint32_t instr) {
+    unsigned opcode = instr & 0x7F;
+    return opcode == 0x63 || opcode == 0x6F || opcode == 0x67;
+}
+
+inline void BranchEval::retire(const HartRetire& r) {
+    insns++;
+    if (pending) resolve(prev.pc, prev.instr, r.pc);
+    pending = is_control(r.instr);
+    if (pending) prev = r;
+}
+
+inline void BranchEval::resolve(uint32_t pc, uint32_t instr, uint32_t next) {
+    Site* site = 0;
+    if ((instr & 0x7F) == 0x63) {
+        site = &sites[pc];
+        if (site->miss.empty()) {
+            site->execs = site->taken = 0;
+            site->miss.assign(preds.size(), 0);
+        }
+        site->execs++;
+    }
+    for (size_t i = 0; i < preds.size(); i++) {
+        bool ok = preds[i].step(pc, instr, next);
+        if (site && !ok) site->miss[i]++;
+    }
+    if (site && preds.size()) {
+        // Every predictor derives the same outcome; count it once
+        if (next != pc + 4) site->taken++;
+    }
+}
+
+inline void BranchEval::print(std::ostream& os) const {
+    os << "\n==================================================================\n";
+    os << "  BRANCH PREDICTION: " << std::dec << insns << " instructions\n";
+    os << "==================================================================\n";
+    os << std::left << std::setw(30) << "predictor" << std::right << std::setw(9) << "branch%"
+       << std::setw(9) << "jalr%" << std::setw(9) << "ret%" << std::setw(8) << "MPKI" << std::setw(10) << "btb miss" << "\n";
+    for (size_t i = 0; i < preds.size(); i++) {
+        const BranchPredictor& p = preds[i];
+        const PredictorStats&  s = p.stats();
+        auto pct = [](uint64_t miss, uint64_t n) { return n ? 100.0 * (double)miss / (double)n : 0.0; };
+        os << std::left << std::setw(30) << ("#" + std::to_string(i + 1) + " " + predictor_name(p.config())) << std::right << std::fixed << std::setprecision(2)
+           << std::setw(8) << pct(s.branch_miss, s.branches) << "%" << std::setw(8) << pct(s.jump_miss, s.jumps) << "%"
+           << std::setw(8) << pct(s.return_miss, s.returns) << "%" << std::setw(8)
+           << (insns ? 1000.0 * (double)s.misses() / (double)insns : 0.0);
+        if (p.config().btb_entries) os << std::setw(10) << s.btb_miss;
+        os << "\n";
+    }
+    if (!preds.empty()) {
+        const PredictorStats& s = preds[0].stats();
+        os << "  " << s.branches << " branches, " << s.jumps << " indirect jumps, " << s.returns << " returns\n";
+    }
+    os.unsetf(std::ios::floatfield);
+    os << std::setprecision(6);
+}
+
+inline void BranchEval::print_branches(std::ostream& os, unsigned top, std::vector<ProfileSymbol> syms) const {
+    profile_sort_symbols(syms);
+
+    std::vector<std::pair<uint64_t, uint32_t> > order; // Total misses, pc
+    for (const auto& kv : sites) {
+        uint64_t n = 0;
+        for (uint32_t m : kv.second.miss) n += m;
+        if (n) order.push_back(std::make_pair(n, kv.first));
+    }
+    std::sort(order.begin(), order.end(), [](const std::pair<uint64_t, uint32_t>& a, const std::pair<uint64_t, uint32_t>& b) {
+        return a.first != b.first ? a.first > b.first : a.second < b.second;
+    });
+    if (top && order.size() > top) order.resize(top);
+
+    os << "\n  Hardest branches (mispredictions per predictor)\n";
+    os << std::right << std::setw(12) << "pc" << std::setw(11) << "execs" << std::setw(8) << "taken%";
+    for (size_t i = 0; i < preds.size(); i++) os << std::setw(9) << ("#" + std::to_string(i + 1));
+    os << "  function\n";
+    for (const auto& o : order) {
+        const Site& s = sites.find(o.second)->second;
+        os << "  0x" << std::hex << std::setw(8) << std::setfill('0') << o.second << std::setfill(' ') << std::dec
+           << std::setw(11) << s.execs << std::fixed << std::setprecision(1) << std::setw(7)
+           << 100.0 * (double)s.taken / (double)s.execs << "%";
+        for (uint32_t m : s.miss) os << std::setw(9) << m;
+        size_t k = profile_find(syms, o.second);
+        os << "  " << (k < syms.size() ? syms[k].name : "?") << "\n";
+    }
+    os.unsetf(std::ios::floatfield);
+    os << std::setprecision(6);
+}
+
+#endif // BRANCH_PRED_H
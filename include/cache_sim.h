@@ -0,0 +1,350 @@
+#ifndef CACHE_SIM_H
+#define CACHE_SIM_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include "core.h"
+
+// =======================================================
+// Trace-Driven Cache Simulator (C-Sim Only)
+// =======================================================
+// Models I- and D-caches on the address streams the core produces, to size
+// BRAM caches for the HLS core. The fetch stream is the pc of every retired
+// instruction; the data stream is the load / store / AMO address of the
+// retire hook (HartRetire::mem_addr). Both are exactly what fetch() and
+// memory() put on m_axi, because the core fetches nothing it does not
+// retire. MMIO (below DRAM_BASE) is never cached.
+//
+// AXI accounting, per cache:
+//   uncached   what fetch() / memory() issue without a cache (cache_bus_txns):
+//              one read per fetch, one read per load, a read and a write
+//              per store (loads and stores: twice when they cross a word),
+//              a read and a write per AMO; CLINT registers cost nothing
+//   cached     one burst per line fill, one burst per dirty eviction
+//              (write-back), one single-beat write per store (write-through);
+//              MMIO as uncached
+// 'words' counts 32-bit beats, so bursts that move more data than they
+// save show up even when the transaction count drops.
+
+enum CacheRepl { CACHE_LRU, CACHE_FIFO, CACHE_RANDOM };
+
+struct CacheConfig {
+    unsigned  size;           // Bytes of data
+    unsigned  ways;           // 1 = direct mapped
+    unsigned  line;           // Bytes per line (power of two, >= 4)
+    bool      write_back;     // false = write-through
+    bool      write_allocate; // Stores that miss fill the line
+    CacheRepl repl;
+};
+
+struct CacheStats {
+    uint64_t accesses;
+    uint64_t hits;
+    uint64_t reads;        // Loads and fetches (AMOs count as both)
+    uint64_t writes;
+    uint64_t fills;        // Lines read from memory
+    uint64_t writebacks;   // Dirty lines written back (including flush)
+    uint64_t uncached;     // MMIO accesses passed through
+    uint64_t txn_base;     // AXI transactions without a cache
+    uint64_t txn;          // AXI transactions with this cache
+    uint64_t words;        // 32-bit beats with this cache
+
+    void     add(const CacheStats& o);
+    double   hit_rate() const { uint64_t n = accesses - uncached; return n ? 100.0 * (double)hits / (double)n : 0.0; }
+};
+
+// "8K 2w 32B wb lru"
+std::string cache_config_name(const CacheConfig& c);
+
+// Estimated 36 Kb block RAMs for data plus tags (valid, dirty and tag bits)
+unsigned    cache_bram36(const CacheConfig& c);
+
+// Every combination of sizes x ways x lines with the given policy
+std::vector<CacheConfig> cache_config_grid(const std::vector<unsigned>& sizes, const std::vector<unsigned>& ways,
+                                           const std::vector<unsigned>& lines, bool write_back, CacheRepl repl);
+
+class CacheSim {
+public:
+    explicit CacheSim(const CacheConfig& cfg);
+
+    // One access to 'addr', which costs the uncached core 'bus' single-beat
+    // AXI transactions; true on a hit
+    bool     access(uint32_t addr, bool read, bool write, unsigned bus);
+    // Writes back every dirty line (end of run)
+    void     flush();
+    void     reset();
+
+    const CacheConfig& config() const { return cfg; }
+    const CacheStats&  stats() const  { return st; }
+
+private:
+    CacheConfig           cfg;
+    CacheStats            st;
+    unsigned              sets;
+    unsigned              line_shift;
+    std::vector<uint32_t> tags;   // sets * ways
+    std::vector<uint64_t> stamp;  // LRU: last use, FIFO: fill time
+    std::vector<uint8_t>  state;  // Bit 0 valid, bit 1 dirty
+    uint64_t              clock;
+    uint32_t              rng;
+};
+
+// Many I- and D-cache configurations on one run's streams. Every retired
+// instruction is a fetch for each I-cache and, if it accessed memory, an
+// access for each D-cache.
+class CacheSweep {
+public:
+    CacheSweep(const std::vector<CacheConfig>& icfg, const std::vector<CacheConfig>& dcfg);
+
+    // Feeds every instruction 'h' retires from now on
+    void     attach(Hart& h);
+    // Detaches from 'h' and flushes dirty lines
+    void     finish(Hart& h);
+
+    // Feeds one retired instruction (for callers with their own hook)
+    void     retire(const HartRetire& r);
+    void     flush();
+
+    const std::vector<CacheSim>& icaches() const { return icache; }
+    const std::vector<CacheSim>& dcaches() const { return dcache; }
+
+private:
+    std::vector<CacheSim> icache;
+    std::vector<CacheSim> dcache;
+
+    static void on_retire(void* ctx, const HartRetire& r);
+};
+
+// AXI transactions memory() issues for 'r' without a D-cache
+unsigned cache_bus_txns(const HartRetire& r);
+
+// Table of one sweep: config, hit rate, AXI transactions and beats against
+// the uncached core, estimated BRAM36
+void cache_print(std::ostream& os, const char* title, const std::vector<CacheConfig>& cfgs,
+                 const std::vector<CacheStats>& stats);
+
+// --- Implementations ---
+
+inline void CacheStats::add(const CacheStats& o) {
+    accesses   += o.accesses;
+    hits       += o.hits;
+    reads      += o.reads;
+    writes     += o.writes;
+    fills      += o.fills;
+    writebacks += o.writebacks;
+    uncached   += o.uncached;
+    txn_base   += o.txn_base;
+    txn        += o.txn;
+    words      += o.words;
+}
+
+inline std::string cache_config_name(const CacheConfig& c) {
+    static const char* repl[] = {"lru", "fifo", "rand"};
+    char buf[64];
+    if (c.size >= 1024) snprintf(buf, sizeof(buf), "%uK", c.size / 1024);
+    else                snprintf(buf, sizeof(buf), "%uB", c.size);
+    std::string s = buf;
+    snprintf(buf, sizeof(buf), " %uw %uB %s %s", c.ways, c.line, c.write_back ? "wb" : "wt", repl[c.repl]);
+    return s + buf;
+}
+
+inline unsigned cache_bram36(const CacheConfig& c) {
+    unsigned sets = c.size / (c.line * c.ways);
+    unsigned tag  = 32;
+    for (unsigned v = c.line; v > 1; v >>= 1) tag--;
+    for (unsigned v = sets;   v > 1; v >>= 1) tag--;
+    uint64_t data_bits = (uint64_t)c.size * 8;
+    uint64_t tag_bits  = (uint64_t)sets * c.ways * (tag + 2);
+    const uint64_t BRAM36 = 36864;
+    return (unsigned)((data_bits + BRAM36 - 1) / BRAM36 + (tag_bits + BRAM36 - 1) / BRAM36);
+}
+
+inline std::vector<CacheConfig> cache_config_grid(const std::vector<unsigned>& sizes, const std::vector<unsigned>& ways,
+                                                  const std::vector<unsigned>& lines, bool write_back, CacheRepl repl) {
+    std::vector<CacheConfig> out;
+    for (unsigned s : sizes) {
+        for (unsigned w : ways) {
+            for (unsigned l : lines) {
+                if (s < w * l) continue; // Less than one set
+                CacheConfig c;
+                c.size           = s;
+                c.ways           = w;
+                c.line           = l;
+                c.write_back     = write_back;
+                c.write_allocate = write_back;
+                c.repl           = repl;
+                out.push_back(c);
+            }
+        }
+    }
+    return out;
+}
+
+inline CacheSim::CacheSim(const CacheConfig& c) : cfg(c) {
+    sets       = cfg.size / (cfg.line * cfg.ways);
+    line_shift = 0;
+    while ((1u << line_shift) < cfg.line) line_shift++;
+    tags.resize((size_t)sets * cfg.ways);
+    stamp.resize(tags.size());
+    state.resize(tags.size());
+    reset();
+}
+
+inline void CacheSim::reset() {
+    memset(&st, 0, sizeof(st));
+    std::fill(state.begin(), state.end(), 0);
+    std::fill(stamp.begin(), stamp.end(), 0);
+    clock = 0;
+    rng   = 0x9E3779B9;
+}
+
+inline bool CacheSim::access(uint32_t addr, bool read, bool write, unsigned bus) {
+    st.accesses++;
+    if (read)  st.reads++;
+    if (write) st.writes++;
+    st.txn_base += bus;
+
+    if (addr < DRAM_BASE) { // MMIO
+        st.uncached++;
+        st.txn   += bus;
+        st.words += bus;
+        return false;
+    }
+
+    uint32_t block = addr >> line_shift;
+    unsigned set   = block % sets;
+    uint32_t tag   = block / sets;
+    size_t   base  = (size_t)set * cfg.ways;
+    clock++;
+
+    for (unsigned w = 0; w < cfg.ways; w++) {
+        size_t i = base + w;
+        if ((state[i] & 1) && tags[i] == tag) {
+            st.hits++;
+            if (cfg.repl == CACHE_LRU) stamp[i] = clock;
+            if (write && cfg.write_back) state[i] |= 2;
+            if (write && !cfg.write_back) { st.txn++; st.words++; }
+            return true;
+        }
+    }
+
+    // Miss. A write-through store without allocate goes straight out.
+    if (!read && write && !cfg.write_allocate) {
+        st.txn++;
+        st.words++;
+        return false;
+    }
+
+    size_t victim = base;
+    bool   found  = false;
+    for (unsigned w = 0; w < cfg.ways && !found; w++) {
+        if (!(state[base + w] & 1)) { victim = base + w; found = true; }
+    }
+    if (!found && cfg.repl == CACHE_RANDOM) {
+        rng ^= rng << 13; rng ^= rng >> 17; rng ^= rng << 5;
+        victim = base + rng % cfg.ways;
+    } else if (!found) {
+        for (unsigned w = 1; w < cfg.ways; w++) {
+            if (stamp[base + w] < stamp[victim]) victim = base + w;
+        }
+    }
+    if ((state[victim] & 3) == 3) { // Dirty eviction
+        st.writebacks++;
+        st.txn++;
+        st.words += cfg.line / 4;
+    }
+    st.fills++;
+    st.txn++;
+    st.words += cfg.line / 4;
+    tags[victim]  = tag;
+    stamp[victim] = clock;
+    state[victim] = 1;
+    if (write && cfg.write_back) state[victim] |= 2;
+    if (write && !cfg.write_back) { st.txn++; st.words++; }
+    return false;
+}
+
+inline void CacheSim::flush() {
+    for (size_t i = 0; i < state.size(); i++) {
+        if ((state[i] & 3) != 3) continue;
+        st.writebacks++;
+        st.txn++;
+        st.words += cfg.line / 4;
+        state[i] &= ~2;
+    }
+}
+
+inline CacheSweep::CacheSweep(const std::vector<CacheConfig>& icfg, const std::vector<CacheConfig>& dcfg) {
+    for (const auto& c : icfg) icache.push_back(CacheSim(c));
+    for (const auto& c : dcfg) dcache.push_back(CacheSim(c));
+}
+
+inline void CacheSweep::attach(Hart& h) {
+    hart_retire_hook(h, on_retire, this);
+}
+
+inline void CacheSweep::finish(Hart& h) {
+    hart_retire_hook(h, 0, 0);
+    flush();
+}
+
+inline void CacheSweep::on_retire(void* ctx, const HartRetire& r) {
+    ((CacheSweep*)ctx)->retire(r);
+}
+
+inline unsigned cache_bus_txns(const HartRetire& r) {
+    uint32_t ph = r.mem_addr & 0x07FFFFFF;
+    if ((r.mem_addr & 0xFFFFF000) == 0x10000000) return 1; // UART: one beat, no read-modify-write
+    if (ph == 0x2004000 || ph == 0x2004004 || ph == 0x200BFF8 || ph == 0x200BFFC) return 0; // CLINT (in the core)
+    if ((r.instr & 0x7F) == 0x2F) { // LR reads; SC reads, and writes on success; AMOs read and write
+        unsigned funct5 = r.instr >> 27;
+        if (funct5 == 0x02) return 1;
+        if (funct5 == 0x03) return r.rd_val == 0 ? 2 : 1;
+        return 2;
+    }
+    unsigned size  = 1u << ((r.instr >> 12) & 0x3);
+    unsigned words = (r.mem_addr & 3) + size > 4 ? 2 : 1;
+    if (r.mem & HART_MEM_STORE) return 2 * words; // Read-modify-write per word
+    return words;                                 // Load: word1 only when it crosses
+}
+
+inline void CacheSweep::retire(const HartRetire& r) {
+    for (auto& c : icache) c.access(r.pc, true, false, 1);
+    if (!r.mem) return;
+    bool     rd  = (r.mem & HART_MEM_LOAD) != 0;
+    bool     wr  = (r.mem & HART_MEM_STORE) != 0;
+    unsigned bus = cache_bus_txns(r);
+    for (auto& c : dcache) c.access(r.mem_addr, rd, wr, bus);
+}
+
+inline void CacheSweep::flush() {
+    for (auto& c : dcache) c.flush();
+}
+
+inline void cache_print(std::ostream& os, const char* title, const std::vector<CacheConfig>& cfgs,
+                        const std::vector<CacheStats>& stats) {
+    os << "\n==================================================================\n";
+    os << "  " << title << "\n";
+    os << "==================================================================\n";
+    os << std::left << std::setw(24) << "config" << std::right << std::setw(8) << "hit%" << std::setw(14) << "AXI txns"
+       << std::setw(8) << "saved" << std::setw(14) << "AXI words" << std::setw(8) << "BRAM36" << "\n";
+    for (size_t i = 0; i < cfgs.size() && i < stats.size(); i++) {
+        const CacheStats& s = stats[i];
+        double saved = s.txn_base ? 100.0 * ((double)s.txn_base - (double)s.txn) / (double)s.txn_base : 0.0;
+        os << std::left << std::setw(24) << cache_config_name(cfgs[i]) << std::right << std::fixed << std::setprecision(2)
+           << std::setw(7) << s.hit_rate() << "%" << std::setw(14) << s.txn << std::setprecision(1) << std::setw(7)
+           << saved << "%" << std::setw(14) << s.words << std::setw(8) << cache_bram36(cfgs[i]) << "\n";
+    }
+    if (!stats.empty()) {
+        os << "  uncached: " << stats[0].txn_base << " AXI transactions\n";
+    }
+    os.unsetf(std::ios::floatfield);
+    os << std::setprecision(6);
+}
+
+#endif // CACHE_SIM_H
@@ -0,0 +1,352 @@
+#ifndef CALLTRACE_H
+#define CALLTRACE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include "core.h"
+#include "profiler.h"
+
+// =======================================================
+// Call Graph and Timeline (C-Sim Only)
+// =======================================================
+// Follows the calls, returns and traps reported by hart_call_hook() on a
+// shadow call stack and builds a calling-context tree: one node per call
+// path, so each recursion level of towers() gets its own node. A node has
+// its call count and exclusive cycles (spent in the function itself);
+// inclusive cycles add everything it called. With a timeline, every
+// completed frame is also kept as a Chrome trace event for chrome://tracing
+// or ui.perfetto.dev.
+//
+// Nodes are keyed by call target and named at report time with the
+// profiler's symbols. Tail calls (plain jumps) stay in the caller's frame.
+// A return that matches none of the top frames (longjmp, a context switch)
+// pops one frame; calls beyond max_depth are counted, not pushed.
+
+struct CallNode {
+    uint32_t func;   // Call target (trap frames: mtvec)
+    uint32_t parent; // Node index; the root (node 0) is its own parent
+    uint32_t depth;
+    bool     trap;   // Entered by a trap instead of a call
+    uint64_t calls;
+    uint64_t self;   // Exclusive cycles
+    uint64_t total;  // Inclusive cycles (set by finish)
+};
+
+struct CallEvent { // One completed frame of the timeline
+    uint64_t begin;
+    uint64_t end;
+    uint32_t node;
+};
+
+class CallTracer {
+public:
+    // max_events: timeline frames to keep (0 = no timeline)
+    explicit CallTracer(size_t max_events = 0, unsigned max_depth = 1024);
+
+    // Symbols for the reports (unnamed addresses print as hex)
+    void symbols(std::vector<ProfileSymbol> syms);
+
+    // Starts tracing 'h' at its current pc and mcycle
+    void attach(Hart& h);
+    // Closes every open frame at the current mcycle and detaches from 'h'
+    void finish(Hart& h);
+
+    // Call tree, hottest child first; subtrees under min_pct of all cycles are skipped
+    void print_tree(std::ostream& os, double min_pct) const;
+    // Per-function inclusive cycles (recursion counted once) and exclusive cycles
+    void print_functions(std::ostream& os, unsigned top) const;
+    // Collapsed stacks, one line per call path, weighted by exclusive cycles
+    bool write_folded(const char* path) const;
+    // Chrome trace-event JSON; timestamps in microseconds at clock_mhz
+    bool write_chrome_trace(const char* path, double clock_mhz) const;
+
+    const std::vector<CallNode>& nodes() const { return tree; }
+
+private:
+    struct Frame {
+        uint32_t node;
+        uint32_t ret;   // Expected return address (trap frames: mepc)
+        uint64_t begin;
+    };
+
+    static const unsigned RETURN_SEARCH = 8; // Frames a return may skip (unwinding)
+
+    std::vector<CallNode>                  tree;
+    std::unordered_map<uint64_t, uint32_t> children; // (parent, trap, func) -> node
+    std::vector<Frame>                     stack;
+    std::vector<CallEvent>                 events;
+    std::vector<ProfileSymbol>             syms;
+    size_t   max_events;
+    unsigned max_depth;
+    unsigned overflow;  // Calls not pushed because of max_depth
+    uint64_t dropped;   // Timeline frames past max_events
+    uint64_t start;
+    uint64_t last;      // Cycle of the previous event
+
+    static void on_event(void* ctx, HartCallKind kind, uint32_t pc, uint32_t target, uint64_t cycle);
+    void        event(HartCallKind kind, uint32_t pc, uint32_t target, uint64_t cycle);
+    void        push(uint32_t func, uint32_t ret, bool trap, uint64_t cycle);
+    void        pop_to(size_t level, uint64_t cycle);
+    std::string name(uint32_t node) const;
+    void        print_node(std::ostream& os, const std::vector<std::vector<uint32_t> >& kids,
+                           uint32_t node, uint64_t min_cycles) const;
+};
+
+// --- Implementations ---
+
+inline CallTracer::CallTracer(size_t max_events, unsigned max_depth)
+    : max_events(max_events), max_depth(max_depth), overflow(0), dropped(0), start(0), last(0) {}
+
+inline void CallTracer::symbols(std::vector<ProfileSymbol> s) {
+    profile_sort_symbols(s);
+    syms.swap(s);
+}
+
+inline void CallTracer::attach(Hart& h) {
+    tree.clear();
+    children.clear();
+    stack.clear();
+    events.clear();
+    overflow = 0;
+    dropped  = 0;
+    start = last = (uint64_t)h.csr_mcycle;
+
+    CallNode root = { (uint32_t)(uword_t)h.pc, 0, 0, false, 1, 0, 0 };
+    tree.push_back(root);
+    Frame f = { 0, 0, start };
+    stack.push_back(f);
+    hart_call_hook(h, on_event, this);
+}
+
+inline void CallTracer::finish(Hart& h) {
+    hart_call_hook(h, 0, 0);
+    if (stack.empty()) return;
+
+    uint64_t now = (uint64_t)h.csr_mcycle;
+    tree[stack.back().node].self += now - last;
+    last = now;
+    pop_to(0, now);
+
+    // Children are created after their parent: one backward pass sums the subtrees
+    for (auto& n : tree) n.total = n.self;
+    for (size_t i = tree.size() - 1; i > 0; i--) tree[tree[i].parent].total += tree[i].total;
+}
+
+inline void CallTracer::on_event(void* ctx, HartCallKind kind, uint32_t pc, uint32_t target, uint64_t cycle) {
+    ((CallTracer*)ctx)->event(kind, pc, target, cycle);
+}
+
+inline void CallTracer::event(HartCallKind kind, uint32_t pc, uint32_t target, uint64_t cycle) {
+    // Cycles up to and including the transfer belong to the current frame
+    tree[stack.back().node].self += cycle - last;
+    last = cycle;
+
+    size_t n = stack.size();
+    switch (kind) {
+        case HART_CALL: push(target, pc + 4, false, cycle); break;
+        case HART_TRAP: push(target, pc, true, cycle); break;
+        case HART_RETURN: {
+            if (overflow) { overflow--; break; }
+            // Nearest frame expecting this address, without unwinding a trap
+            size_t hit = 0;
+            for (size_t i = n - 1; i > 0 && n - i <= RETURN_SEARCH; i--) {
+                if (stack[i].ret == target) { hit = i; break; }
+                if (tree[stack[i].node].trap) break;
+            }
+            if (hit)                                         pop_to(hit, cycle);
+            else if (n > 1 && !tree[stack[n - 1].node].trap) pop_to(n - 1, cycle);
+            break;
+        }
+        case HART_TRAP_RETURN: {
+            if (overflow) { overflow--; break; }
+            for (size_t i = n - 1; i > 0; i--) {
+                if (tree[stack[i].node].trap) { pop_to(i, cycle); break; }
+            }
+            break;
+        }
+    }
+}
+
+inline void CallTracer::push(uint32_t func, uint32_t ret, bool trap, uint64_t cycle) {
+    if (stack.size() > max_depth) { overflow++; return; }
+
+    uint32_t parent = stack.back().node;
+    uint64_t key = ((uint64_t)parent << 33) | ((uint64_t)trap << 32) | func;
+    auto it = children.find(key);
+    uint32_t node;
+    if (it != children.end()) {
+        node = it->second;
+    } else {
+        node = (uint32_t)tree.size();
+        CallNode c = { func, parent, tree[parent].depth + 1, trap, 0, 0, 0 };
+        tree.push_back(c);
+        children[key] = node;
+    }
+    tree[node].calls++;
+
+    Frame f = { node, ret, cycle };
+    stack.push_back(f);
+}
+
+inline void CallTracer::pop_to(size_t level, uint64_t cycle) {
+    while (stack.size() > level) {
+        if (max_events) {
+            CallEvent e = { stack.back().begin, cycle, stack.back().node };
+            if (events.size() < max_events) events.push_back(e);
+            else                            dropped++;
+        }
+        stack.pop_back();
+    }
+}
+
+inline std::string CallTracer::name(uint32_t node) const {
+    const CallNode& n = tree[node];
+    size_t s = profile_find(syms, n.func);
+    std::string out;
+    if (s < syms.size()) {
+        out = syms[s].name;
+    } else {
+        char buf[16];
+        snprintf(buf, sizeof(buf), "0x%08x", (unsigned)n.func);
+        out = buf;
+    }
+    return n.trap ? "[trap] " + out : out;
+}
+
+inline void CallTracer::print_node(std::ostream& os, const std::vector<std::vector<uint32_t> >& kids,
+                                   uint32_t node, uint64_t min_cycles) const {
+    const CallNode& n = tree[node];
+    double pct = tree[0].total ? 100.0 * (double)n.total / (double)tree[0].total : 0.0;
+    os << std::right << std::fixed << std::setprecision(2) << std::setw(6) << pct << "%"
+       << std::setw(14) << n.total << std::setw(14) << n.self << std::setw(10) << n.calls << "  "
+       << std::string(2 * n.depth, ' ') << name(node) << "\n";
+    for (uint32_t c : kids[node]) {
+        if (tree[c].total >= min_cycles) print_node(os, kids, c, min_cycles);
+    }
+}
+
+inline void CallTracer::print_tree(std::ostream& os, double min_pct) const {
+    if (tree.empty()) return;
+    std::vector<std::vector<uint32_t> > kids(tree.size());
+    for (uint32_t i = 1; i < tree.size(); i++) kids[tree[i].parent].push_back(i);
+    for (auto& k : kids) {
+        std::sort(k.begin(), k.end(), [this](uint32_t a, uint32_t b) { return tree[a].total > tree[b].total; });
+    }
+
+    os << "\n==================================================================\n";
+    os << "  CALL TREE: " << std::dec << tree[0].total << " cycles, " << tree.size() << " call paths\n";
+    os << "==================================================================\n";
+    os << std::right << std::setw(7) << "incl%" << std::setw(14) << "inclusive" << std::setw(14) << "exclusive"
+       << std::setw(10) << "calls" << "  " << "function\n";
+    print_node(os, kids, 0, (uint64_t)(min_pct / 100.0 * (double)tree[0].total));
+    os << std::right;
+}
+
+inline void CallTracer::print_functions(std::ostream& os, unsigned top) const {
+    if (tree.empty()) return;
+    struct Func { std::string name; uint64_t incl, excl, calls; };
+    std::vector<std::string> names(tree.size());
+    for (uint32_t i = 0; i < tree.size(); i++) names[i] = name(i);
+
+    std::unordered_map<std::string, size_t> slot;
+    std::vector<Func> funcs;
+    for (uint32_t i = 0; i < tree.size(); i++) {
+        auto it = slot.find(names[i]);
+        if (it == slot.end()) {
+            it = slot.insert(std::make_pair(names[i], funcs.size())).first;
+            Func f = { names[i], 0, 0, 0 };
+            funcs.push_back(f);
+        }
+        Func& f = funcs[it->second];
+        f.excl  += tree[i].self;
+        f.calls += tree[i].calls;
+
+        // Inclusive time only at the outermost activation of a recursion
+        bool nested = false;
+        for (uint32_t p = i; p != 0 && !nested; ) {
+            p = tree[p].parent;
+            nested = (names[p] == names[i]);
+        }
+        if (!nested) f.incl += tree[i].total;
+    }
+    std::sort(funcs.begin(), funcs.end(), [](const Func& a, const Func& b) { return a.incl > b.incl; });
+
+    os << "\n==================================================================\n";
+    os << "  FUNCTIONS BY INCLUSIVE CYCLES\n";
+    os << "==================================================================\n";
+    os << std::right << std::setw(7) << "incl%" << std::setw(14) << "inclusive" << std::setw(14) << "exclusive"
+       << std::setw(10) << "calls" << "  " << "function\n";
+    unsigned n = 0;
+    for (const auto& f : funcs) {
+        if (top && n++ == top) break;
+        double pct = tree[0].total ? 100.0 * (double)f.incl / (double)tree[0].total : 0.0;
+        os << std::right << std::fixed << std::setprecision(2) << std::setw(6) << pct << "%"
+           << std::setw(14) << f.incl << std::setw(14) << f.excl << std::setw(10) << f.calls
+           << "  " << std::left << f.name << "\n";
+    }
+    os << std::right;
+}
+
+inline bool CallTracer::write_folded(const char* path) const {
+    std::ofstream f(path);
+    if (!f) {
+        std::cerr << "[CALL] Error: cannot create " << path << "\n";
+        return false;
+    }
+    std::vector<uint32_t> chain;
+    for (uint32_t i = 0; i < tree.size(); i++) {
+        if (tree[i].self == 0) continue;
+        chain.clear();
+        for (uint32_t p = i; ; p = tree[p].parent) {
+            chain.push_back(p);
+            if (p == 0) break;
+        }
+        for (size_t k = chain.size(); k-- > 0; ) f << name(chain[k]) << (k ? ";" : " ");
+        f << tree[i].self << "\n";
+    }
+    return (bool)f;
+}
+
+inline bool CallTracer::write_chrome_trace(const char* path, double clock_mhz) const {
+    std::ofstream f(path);
+    if (!f) {
+        std::cerr << "[CALL] Error: cannot create " << path << "\n";
+        return false;
+    }
+
+    // Outer frames first at equal timestamps, so viewers nest them correctly
+    std::vector<CallEvent> sorted(events);
+    std::sort(sorted.begin(), sorted.end(), [](const CallEvent& a, const CallEvent& b) {
+        return a.begin != b.begin ? a.begin < b.begin : a.end > b.end;
+    });
+
+    f << "{\"traceEvents\":[\n";
+    f << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"hart 0\"}}";
+    f << std::fixed << std::setprecision(3);
+    for (const auto& e : sorted) {
+        std::string n = name(e.node);
+        std::string esc;
+        for (char ch : n) {
+            if (ch == '"' || ch == '\\') esc += '\\';
+            esc += ch;
+        }
+        f << ",\n{\"name\":\"" << esc << "\",\"ph\":\"X\",\"pid\":1,\"tid\":1"
+          << ",\"ts\":" << (double)(e.begin - start) / clock_mhz
+          << ",\"dur\":" << (double)(e.end - e.begin) / clock_mhz << "}";
+    }
+    f << "\n]}\n";
+
+    if (dropped) {
+        std::cout << "[CALL] Timeline truncated: " << dropped << " frames past " << max_events << " events\n";
+    }
+    return (bool)f;
+}
+
+#endif // CALLTRACE_H
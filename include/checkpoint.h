@@ -0,0 +1,243 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <iostream>
+#include "core.h"
+#include "guest_memory.h"
+
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
+
+// =======================================================
+// Architectural Checkpoints (C-Sim Only)
+// =======================================================
+// Saves a Hart plus its written RAM pages to a file and resumes from it, so
+// a long boot only has to be simulated once. Layout (little-endian):
+//
+//   0x0000          CheckpointHeader, zero-padded to CKPT_ALIGN
+//   CKPT_ALIGN      uint32_t page number for each saved page
+//   data_offset     PAGE_WORDS words per saved page, in table order
+//
+// Page data is CKPT_ALIGN-aligned, so the file can be mapped and copied (or
+// mapped in place) page by page. Only non-zero pages are stored.
+
+static const char     CKPT_MAGIC[8] = {'R', 'V', 'C', 'K', 'P', 'T', 0, 0};
+static const uint32_t CKPT_VERSION  = 1;
+static const uint32_t CKPT_ALIGN    = 4096;
+
+struct CheckpointHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t page_words;  // GuestMemory::PAGE_WORDS at save time
+    uint32_t num_pages;   // Entries in the page table
+    uint32_t data_offset; // File offset of the first page
+
+    // --- Hart ---
+    uint32_t pc;
+    uint32_t regfile[32];
+    uint32_t is_finished;
+    uint32_t lr_addr;
+    uint32_t lr_valid;
+
+    uint32_t csr_mtvec;
+    uint32_t csr_mepc;
+    uint32_t csr_mcause;
+    uint32_t csr_mscratch;
+    uint32_t csr_mstatus;
+    uint32_t csr_mie;
+    uint32_t csr_mip;
+    uint32_t csr_mtval;
+    uint32_t csr_medeleg;
+    uint32_t csr_mideleg;
+    uint32_t csr_mcountinhibit;
+    uint32_t csr_satp;
+
+    uint64_t csr_mcycle;
+    uint64_t csr_minstret;
+    uint64_t mtimecmp;
+};
+
+// Writes 'h' and every non-zero written page of 'mem' to 'path'
+bool checkpoint_save(const char* path, const Hart& h, GuestMemory& mem);
+
+// Replaces RAM and the state of 'h' with the checkpoint at 'path'
+bool checkpoint_load(const char* path, Hart& h, GuestMemory& mem);
+
+// --- Implementations ---
+
+inline void checkpoint_pack(CheckpointHeader& c, const Hart& h) {
+    c.pc = (uint32_t)(uword_t)h.pc;
+    for (int i = 0; i < 32; i++) c.regfile[i] = (uint32_t)(uword_t)h.regfile[i];
+    c.is_finished = h.is_finished;
+    c.lr_addr     = (uint32_t)(uword_t)h.lr_addr;
+    c.lr_valid    = h.lr_valid;
+
+    c.csr_mtvec         = (uint32_t)(uword_t)h.csr_mtvec;
+    c.csr_mepc          = (uint32_t)(uword_t)h.csr_mepc;
+    c.csr_mcause        = (uint32_t)(uword_t)h.csr_mcause;
+    c.csr_mscratch      = (uint32_t)(uword_t)h.csr_mscratch;
+    c.csr_mstatus       = (uint32_t)(uword_t)h.csr_mstatus;
+    c.csr_mie           = (uint32_t)(uword_t)h.csr_mie;
+    c.csr_mip           = (uint32_t)(uword_t)h.csr_mip;
+    c.csr_mtval         = (uint32_t)(uword_t)h.csr_mtval;
+    c.csr_medeleg       = (uint32_t)(uword_t)h.csr_medeleg;
+    c.csr_mideleg       = (uint32_t)(uword_t)h.csr_mideleg;
+    c.csr_mcountinhibit = (uint32_t)(uword_t)h.csr_mcountinhibit;
+    c.csr_satp          = (uint32_t)(uword_t)h.csr_satp;
+
+    c.csr_mcycle   = (uint64_t)h.csr_mcycle;
+    c.csr_minstret = (uint64_t)h.csr_minstret;
+    c.mtimecmp     = (uint64_t)h.mtimecmp;
+}
+
+inline void checkpoint_unpack(Hart& h, const CheckpointHeader& c) {
+    h.pc = (uword_t)c.pc;
+    for (int i = 0; i < 32; i++) h.regfile[i] = (sword_t)(int32_t)c.regfile[i];
+    h.regfile[0]  = 0;
+    h.is_finished = c.is_finished != 0;
+    h.lr_addr     = (uword_t)c.lr_addr;
+    h.lr_valid    = c.lr_valid != 0;
+
+    h.csr_mtvec         = (uword_t)c.csr_mtvec;
+    h.csr_mepc          = (uword_t)c.csr_mepc;
+    h.csr_mcause        = (uword_t)c.csr_mcause;
+    h.csr_mscratch      = (uword_t)c.csr_mscratch;
+    h.csr_mstatus       = (uword_t)c.csr_mstatus;
+    h.csr_mie           = (uword_t)c.csr_mie;
+    h.csr_mip           = (uword_t)c.csr_mip;
+    h.csr_mtval         = (uword_t)c.csr_mtval;
+    h.csr_medeleg       = (uword_t)c.csr_medeleg;
+    h.csr_mideleg       = (uword_t)c.csr_mideleg;
+    h.csr_mcountinhibit = (uword_t)c.csr_mcountinhibit;
+    h.csr_satp          = (uword_t)c.csr_satp;
+
+    h.csr_mcycle   = (udword_t)c.csr_mcycle;
+    h.csr_minstret = (udword_t)c.csr_minstret;
+    h.mtimecmp     = (udword_t)c.mtimecmp;
+}
+
+inline bool checkpoint_page_zero(const uint32_t* p) {
+    for (unsigned i = 0; i < GuestMemory::PAGE_WORDS; i++) {
+        if (p[i]) return false;
+    }
+    return true;
+}
+
+inline bool checkpoint_save(const char* path, const Hart& h, GuestMemory& mem) {
+    const uint32_t* ram = (const uint32_t*)mem.words();
+
+    std::vector<uint32_t> pages;
+    for (unsigned p = 0; p < GuestMemory::NUM_PAGES; p++) {
+        if (mem.written(p) && !checkpoint_page_zero(&ram[(size_t)p * GuestMemory::PAGE_WORDS])) pages.push_back(p);
+    }
+
+    CheckpointHeader c;
+    memset(&c, 0, sizeof(c));
+    memcpy(c.magic, CKPT_MAGIC, sizeof(c.magic));
+    c.version     = CKPT_VERSION;
+    c.page_words  = GuestMemory::PAGE_WORDS;
+    c.num_pages   = (uint32_t)pages.size();
+    c.data_offset = (CKPT_ALIGN + c.num_pages * 4 + CKPT_ALIGN - 1) & ~(CKPT_ALIGN - 1);
+    checkpoint_pack(c, h);
+
+    FILE* f = fopen(path, "wb");
+    if (!f) {
+        std::cerr << "[CKPT] Error: could not create " << path << "\n";
+        return false;
+    }
+
+    // Header and page table, each padded to the next CKPT_ALIGN boundary
+    std::vector<uint8_t> head(c.data_offset, 0);
+    memcpy(&head[0], &c, sizeof(c));
+    if (!pages.empty()) memcpy(&head[CKPT_ALIGN], &pages[0], pages.size() * 4);
+
+    bool ok = fwrite(&head[0], 1, head.size(), f) == head.size();
+    for (size_t i = 0; ok && i < pages.size(); i++) {
+        ok = fwrite(&ram[(size_t)pages[i] * GuestMemory::PAGE_WORDS], 4, GuestMemory::PAGE_WORDS, f) == GuestMemory::PAGE_WORDS;
+    }
+    ok = (fclose(f) == 0) && ok;
+
+    if (!ok) std::cerr << "[CKPT] Error: write to " << path << " failed\n";
+    else     std::cout << "[CKPT] Saved " << path << " (pc=0x" << std::hex << c.pc << std::dec
+                       << ", cycle " << c.csr_mcycle << ", " << pages.size() << " pages)\n";
+    return ok;
+}
+
+inline bool checkpoint_load(const char* path, Hart& h, GuestMemory& mem) {
+    // Map the file read-only; hosts without mmap read it into a buffer
+    #ifdef _WIN32
+        std::vector<uint8_t> buf;
+        FILE* f = fopen(path, "rb");
+        if (f) {
+            fseek(f, 0, SEEK_END);
+            buf.resize((size_t)ftell(f));
+            fseek(f, 0, SEEK_SET);
+            if (buf.empty() || fread(&buf[0], 1, buf.size(), f) != buf.size()) buf.clear();
+            fclose(f);
+        }
+        const uint8_t* file = buf.empty() ? 0 : &buf[0];
+        size_t size = buf.size();
+    #else
+        const uint8_t* file = 0;
+        size_t size = 0;
+        int fd = open(path, O_RDONLY);
+        struct stat st;
+        if (fd >= 0 && fstat(fd, &st) == 0 && st.st_size > 0) {
+            size = (size_t)st.st_size;
+            void* p = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            file = (p == MAP_FAILED) ? 0 : (const uint8_t*)p;
+        }
+        if (fd >= 0) close(fd);
+    #endif
+
+    if (!file) {
+        std::cerr << "[CKPT] Error: could not read " << path << "\n";
+        return false;
+    }
+
+    CheckpointHeader c;
+    bool ok = size >= CKPT_ALIGN;
+    if (ok) memcpy(&c, file, sizeof(c));
+    ok = ok && memcmp(c.magic, CKPT_MAGIC, sizeof(c.magic)) == 0
+            && c.version == CKPT_VERSION
+            && c.page_words == GuestMemory::PAGE_WORDS
+            && c.data_offset >= CKPT_ALIGN + (uint64_t)c.num_pages * 4
+            && c.data_offset + (uint64_t)c.num_pages * GuestMemory::PAGE_WORDS * 4 <= size;
+
+    if (ok) {
+        const uint32_t* table = (const uint32_t*)(file + CKPT_ALIGN);
+        const uint8_t*  data  = file + c.data_offset;
+        uint32_t*       ram   = (uint32_t*)mem.words();
+
+        mem.reset();
+        for (uint32_t i = 0; ok && i < c.num_pages; i++) {
+            uint32_t p = table[i];
+            if (p >= GuestMemory::NUM_PAGES) { ok = false; break; }
+            memcpy(&ram[(size_t)p * GuestMemory::PAGE_WORDS], data + (size_t)i * GuestMemory::PAGE_WORDS * 4, GuestMemory::PAGE_WORDS * 4);
+            mem.mark_dirty((size_t)p * GuestMemory::PAGE_WORDS, GuestMemory::PAGE_WORDS);
+        }
+
+        Hart state = h;
+        checkpoint_unpack(state, c);
+        hart_restore(h, state);
+    }
+
+    #ifndef _WIN32
+        munmap((void*)file, size);
+    #endif
+
+    if (!ok) std::cerr << "[CKPT] Error: " << path << " is not a valid checkpoint\n";
+    else     std::cout << "[CKPT] Resumed " << path << " (pc=0x" << std::hex << c.pc << std::dec
+                       << ", cycle " << c.csr_mcycle << ", " << c.num_pages << " pages)\n";
+    return ok;
+}
+
+#endif // CHECKPOINT_H
@@ -3,16 +3,63 @@
 
 #include <ap_int.h>
 #include <iostream>
+#include <cstdint>
+
+// =======================================================
+// Core Word Types
+// =======================================================
+// The stage functions are written against these names. Synthesis and the
+// default C-sim use ap_int; a C-sim build with -DCORE_FAST_SIM instantiates
+// the same source with native integers (bit-identical, much faster).
+#if defined(CORE_FAST_SIM) && !defined(__SYNTHESIS__)
+    #define CORE_NATIVE_WORDS
+    typedef uint32_t uword_t;
+    typedef int32_t  sword_t;
+    typedef uint64_t udword_t;
+    typedef int64_t  sdword_t;
+    typedef uint8_t  opcode_t;
+    typedef uint8_t  regidx_t;
+    typedef uint8_t  funct3_t;
+    typedef uint8_t  funct7_t;
+    typedef uint8_t  amoop_t;
+    typedef uint8_t  shamt_t;
+#else
+    typedef ap_uint<32> uword_t;
+    typedef ap_int<32>  sword_t;
+    typedef ap_uint<64> udword_t;
+    typedef ap_int<64>  sdword_t;
+    typedef ap_uint<7>  opcode_t;
+    typedef ap_uint<5>  regidx_t;
+    typedef ap_uint<3>  funct3_t;
+    typedef ap_uint<7>  funct7_t;
+    typedef ap_uint<5>  amoop_t;
+    typedef ap_uint<5>  shamt_t;
+#endif
 
 // =======================================================
 // Global memory configuration
 // =======================================================
 #define RAM_SIZE 33554432 
+#define RAM_PAGE_SHIFT 10 // C-Sim write tracking granule: 1024 words (4 KB)
 
 // RISC-V Default Memory Map
 #define DRAM_BASE 0x80000000
 #define DMEM_STACK_TOP 0x87FFFFFF
 
+// Instruction cache geometry (all powers of two). Lines are filled with
+// one AXI burst of ICACHE_LINE_WORDS beats; ENABLE_ICACHE in core.cpp
+// turns the cache off. The default is 8 KB, 2-way, 32-byte lines.
+#define ICACHE_WAYS       2   // 1 = direct mapped
+#define ICACHE_SETS       128
+#define ICACHE_LINE_WORDS 8
+
+// Data cache geometry (powers of two): write-back, write-allocate, with
+// burst refill and eviction; MMIO (below DRAM_BASE) bypasses it.
+// ENABLE_DCACHE in core.cpp turns it off. Default: 16 KB, 2-way, 32 B lines.
+#define DCACHE_WAYS       2   // 1 = direct mapped
+#define DCACHE_SETS       256
+#define DCACHE_LINE_WORDS 8
+
 // =======================================================
 // Global ELF / memory configuration variables
 // =======================================================
@@ -20,15 +67,169 @@ extern ap_uint<32> ENTRY_PC;
 extern ap_uint<32> DTB_ADDR;
 extern bool CORE_DEBUG;
 
+// Per-stage logging is compiled in only when CORE_TRACE is nonzero
+// (-DCORE_TRACE=1 for a debug C-sim build). By default CORE_LOG folds to
+// false, so riscv_step carries no logging branches and CORE_DEBUG has no
+// effect on the core.
+#ifndef CORE_TRACE
+#define CORE_TRACE 0
+#endif
+#define CORE_LOG (CORE_TRACE && CORE_DEBUG)
+#ifndef __SYNTHESIS__
+extern bool CORE_BLOCK_ENGINE; // C-Sim only: basic-block execution mode
+extern bool CORE_JIT;          // C-Sim only: x86-64 translation of hot blocks
+#endif
+
+// =======================================================
+// Hart (Architectural State)
+// =======================================================
+// Everything one core carries from instruction to instruction. The stage
+// functions take it by reference, so C-sim can create several harts and
+// step each on its own thread (a hart must only be used by one thread at a
+// time). Start from a zeroed Hart (Hart h = Hart();) before hart_init.
+#ifndef __SYNTHESIS__
+struct HartSim; // C-Sim only: decode / block / JIT caches (core.cpp)
+#endif
+
+struct Hart {
+    uword_t  pc;
+    sword_t  regfile[32];
+    bool     is_finished;
+
+    // --- Load Reserved / Store Conditional State ---
+    uword_t  lr_addr;
+    bool     lr_valid;
+
+    // --- CSRs ---
+    uword_t  csr_mtvec;
+    uword_t  csr_mepc;
+    uword_t  csr_mcause;
+    uword_t  csr_mscratch;
+
+    udword_t csr_mcycle;   // Cycle Counter (0xB00/0xB80)
+    udword_t csr_minstret; // Instructions Retired (0xB02/0xB82)
+    uword_t  csr_mstatus;  // Status Register (0x300)
+
+    // --- Interrupts & Timer ---
+    uword_t  csr_mie;      // Interrupt Enable Register (0x304)
+    uword_t  csr_mip;      // Interrupt Pending Register (0x344)
+    udword_t mtimecmp;
+    udword_t irq_deadline; // First mcycle an interrupt can be taken (derived)
+
+    // --- Sink CSRs (accept writes, minimal/no effect in M-mode-only core) ---
+    uword_t  csr_mtval;         // Trap Value (0x343)
+    uword_t  csr_medeleg;       // Exception Delegation (0x302) - no S-mode, sink
+    uword_t  csr_mideleg;       // Interrupt Delegation (0x303) - no S-mode, sink
+    uword_t  csr_mcountinhibit; // Counter Inhibit (0x320)
+    uword_t  csr_satp;          // S-mode Address Translation (0x180) - sink
+
+    // --- Instruction Cache (round-robin replacement per set) ---
+    uword_t  icache_data[ICACHE_WAYS][ICACHE_SETS * ICACHE_LINE_WORDS];
+    uword_t  icache_tag[ICACHE_WAYS][ICACHE_SETS];    // Line address / ICACHE_SETS
+    bool     icache_valid[ICACHE_WAYS][ICACHE_SETS];  // Cleared by reset and FENCE.I
+    uint8_t  icache_victim[ICACHE_SETS];              // Way filled on the next miss
+
+    // --- Data Cache (round-robin replacement per set) ---
+    uword_t  dcache_data[DCACHE_WAYS][DCACHE_SETS * DCACHE_LINE_WORDS];
+    uword_t  dcache_tag[DCACHE_WAYS][DCACHE_SETS];    // Line address / DCACHE_SETS
+    bool     dcache_valid[DCACHE_WAYS][DCACHE_SETS];
+    bool     dcache_dirty[DCACHE_WAYS][DCACHE_SETS];  // Written back on eviction, FENCE.I and exit
+    uint8_t  dcache_victim[DCACHE_SETS];
+
+#ifndef __SYNTHESIS__
+    HartSim* sim;          // Created by hart_init, released by hart_free
+#endif
+};
+
+// Resets 'h' to start at 'entry_pc'
+void hart_init(Hart& h, uword_t entry_pc);
+
+// Runs 'h' until the exit ECALL or 'max_cycles' (0 = forever). 'imem' and
+// 'dmem' are the instruction and data ports onto the same memory: pass the
+// same buffer twice. Dirty D-cache lines are written back before it returns.
+void hart_step(Hart& h, volatile uint32_t* imem, volatile uint32_t* dmem, int max_cycles, int* cycles_output);
+
+#ifndef __SYNTHESIS__
+// Same on a C-sim model of a five-stage pipeline: mcycle counts the clocks of
+// an ideal pipeline (every cache access and divide takes one clock), and 'h'
+// stops with every committed instruction complete, so hart_step can take over
+void hart_step_pipelined(Hart& h, volatile uint32_t* imem, volatile uint32_t* dmem, int max_cycles, int* cycles_output);
+
+// Releases the C-sim caches of 'h'
+void hart_free(Hart& h);
+
+// Loads the architectural state of 'state' into 'h' (h keeps its own
+// caches, which are flushed because RAM is normally restored alongside)
+void hart_restore(Hart& h, const Hart& state);
+
+// Cycles skipped by WFI idle fast-forward since hart_init
+uint64_t hart_idle_cycles(const Hart& h);
+
+// Exact per-PC profile: retired instructions and cycles (including WFI idle
+// time and trap entry) for every PC. Cleared by hart_init; off by default.
+void hart_profile(Hart& h, bool enable);
+// Calls fn(ctx, pc, insns, cycles) for every PC with nonzero counts
+void hart_profile_visit(const Hart& h, void (*fn)(void* ctx, uint32_t pc, uint64_t insns, uint64_t cycles), void* ctx);
+
+// Control transfers reported to the call hook. Calls and returns follow the
+// RISC-V link-register convention (x1/x5 in JAL/JALR); traps cover both
+// exceptions and the timer interrupt.
+enum HartCallKind {
+    HART_CALL,        // JAL/JALR writing a link register
+    HART_RETURN,      // JALR through a link register
+    HART_TRAP,        // Trap entry: pc = mepc, target = mtvec
+    HART_TRAP_RETURN  // MRET
+};
+typedef void (*HartCallHook)(void* ctx, HartCallKind kind, uint32_t pc, uint32_t target, uint64_t cycle);
+
+// Calls fn(ctx, ...) for every call, return, trap and MRET, with the mcycle
+// value of the transferring instruction (0 = off). Kept across hart_init.
+void hart_call_hook(Hart& h, HartCallHook fn, void* ctx);
+
+// One retired instruction, as seen by the retire hook
+enum HartMemKind {
+    HART_MEM_LOAD  = 1, // Loads; AMOs set both bits
+    HART_MEM_STORE = 2
+};
+struct HartRetire {
+    uint32_t pc;
+    uint32_t instr;
+    uint32_t rd_val;   // Written value (rd != 0), including load results
+    uint32_t mem_addr; // Effective address (mem != 0)
+    uint32_t mem_val;  // Store data / AMO operand (HART_MEM_STORE)
+    uint8_t  rd;       // Destination register, 0 = none
+    uint8_t  mem;      // HartMemKind bits, 0 = no memory access
+};
+typedef void (*HartRetireHook)(void* ctx, const HartRetire& r);
+
+// Calls fn(ctx, r) for every retired instruction (0 = off). While set, the
+// JIT is bypassed; interpreted blocks still run. Kept across hart_init.
+void hart_retire_hook(Hart& h, HartRetireHook fn, void* ctx);
+
+// Makes the running hart_step return before the next instruction, with
+// is_finished false (e.g. from a hook that found an error)
+void hart_stop(Hart& h);
+
+// RAM word 'idx' as the core sees it: the D-cache copy while the line is
+// cached. 'ram' itself is current only after the hart returns.
+uint32_t hart_mem_read(const Hart& h, const volatile uint32_t* ram, unsigned idx);
+
+// Marks page_map[idx >> RAM_PAGE_SHIFT] = 1 for every RAM word index the
+// core writes (0 = off). Kept across hart_init.
+void hart_track_writes(Hart& h, uint8_t* page_map);
+#endif
+
 // =======================================================
 // Core Interface
 // =======================================================
 
-// Initialization function
+// Initialization function (built-in hart, starts at ENTRY_PC)
 void riscv_init();
 
-// Unified Memory Step Function
+// Step Function: separate instruction (imem) and data (dmem) m_axi masters.
+// Both address the whole bus from 0; the driver / testbench passes the
+// same buffer to both.
 // [UPDATED] 'cycles_output' is now a pointer so the core can write back the final count.
-void riscv_step(volatile uint32_t* ram, int max_cycles, int* cycles_output);
+void riscv_step(volatile uint32_t* imem, volatile uint32_t* dmem, int max_cycles, int* cycles_output);
 
 #endif // CORE_H
\ No newline at end of file
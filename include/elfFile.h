@@ -155,6 +155,7 @@ template <typename ElfShdrT> ElfSection::ElfSection(const ElfShdrT header) {
 
 template <typename ElfSymT> ElfSymbol::ElfSymbol(const ElfSymT sym) {
   offset    = sym.st_value;
+  value     = sym.st_value;
   type      = ELF32_ST_TYPE(sym.st_info);
   section   = sym.st_shndx;
   size      = sym.st_size;
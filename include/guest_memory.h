@@ -0,0 +1,187 @@
+#ifndef GUEST_MEMORY_H
+#define GUEST_MEMORY_H
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <ap_int.h>
+#include "elf.h"
+#include "elfFile.h"
+#include "core.h"
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+#endif
+
+// =======================================================
+// Sparse Guest RAM (C-Sim Only)
+// =======================================================
+// Same flat layout the core expects (index = addr_to_idx), but the
+// RAM_SIZE words are only reserved: the host maps a zero page on first
+// touch, so a 20 KB test costs a few pages instead of 128 MB.
+// The page table is a byte per RAM page (RAM_PAGE_SHIFT): the core marks
+// it through hart_track_writes(), the loader through mark_dirty(), and
+// reset() clears only the marked pages.
+//
+// Snapshots save the written pages plus a copy of the hart. Restoring the
+// snapshot taken (or restored) last only rewrites the pages dirtied since.
+
+// Saved guest state (see GuestMemory::snapshot)
+struct GuestSnapshot {
+    Hart                  hart;  // Architectural state ('sim' is not used)
+    std::vector<uint32_t> pages; // Saved page numbers
+    std::vector<uint32_t> data;  // PAGE_WORDS words per saved page
+    std::vector<uint32_t> slot;  // Per RAM page: index into 'pages', or ~0u
+};
+
+class GuestMemory {
+public:
+    static const unsigned PAGE_WORDS = 1u << RAM_PAGE_SHIFT;
+    static const unsigned NUM_PAGES  = RAM_SIZE / PAGE_WORDS;
+
+    GuestMemory();
+    ~GuestMemory();
+
+    bool               ok() const  { return mem != 0; }
+    ap_uint<32>*       words()     { return mem; }                     // Loaders
+    volatile uint32_t* bus()       { return (volatile uint32_t*)mem; } // hart_step
+    uint8_t*           dirty_map() { return &dirty[0]; }               // hart_track_writes
+
+    // Records a host-side write of 'count' words starting at word 'first_idx'
+    void     mark_dirty(size_t first_idx, size_t count);
+
+    // Zeroes every written page; untouched pages are already zero
+    void     reset();
+    unsigned dirty_count() const;
+    bool     written(unsigned page) const { return dirty[page] || touched[page]; }
+
+    // Saves every written page and the state of 'h' into 'snap'
+    void     snapshot(const Hart& h, GuestSnapshot& snap);
+    // Puts RAM and 'h' back to 'snap'. O(pages written since the last
+    // snapshot/restore of 'snap'); other snapshots fall back to all pages
+    // written since reset().
+    void     restore(Hart& h, const GuestSnapshot& snap);
+
+    // ElfFile::load_to_mem plus dirty marking of every PT_LOAD segment.
+    // Returns the entry PC.
+    uint32_t load_elf(ElfFile& elf);
+
+private:
+    ap_uint<32>*         mem;
+    std::vector<uint8_t> dirty;   // Written since the last reset/snapshot/restore
+    std::vector<uint8_t> touched; // Written since reset() (may be non-zero)
+    const GuestSnapshot* base;    // Snapshot 'dirty' is relative to
+
+    void     fold_dirty();
+
+    GuestMemory(const GuestMemory&);            // Not copyable
+    GuestMemory& operator=(const GuestMemory&);
+};
+
+// --- Implementations ---
+
+inline GuestMemory::GuestMemory() : mem(0), dirty(NUM_PAGES, 0), touched(NUM_PAGES, 0), base(0) {
+    const size_t bytes = (size_t)RAM_SIZE * 4;
+    #ifdef _WIN32
+        // Committed pages are zero-filled on first access
+        mem = (ap_uint<32>*)VirtualAlloc(0, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    #else
+        void* p = mmap(0, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        mem = (p == MAP_FAILED) ? 0 : (ap_uint<32>*)p;
+    #endif
+    if (!mem) std::cerr << "[MEM] Error: could not reserve guest RAM\n";
+}
+
+inline GuestMemory::~GuestMemory() {
+    if (!mem) return;
+    #ifdef _WIN32
+        VirtualFree(mem, 0, MEM_RELEASE);
+    #else
+        munmap(mem, (size_t)RAM_SIZE * 4);
+    #endif
+}
+
+inline void GuestMemory::mark_dirty(size_t first_idx, size_t count) {
+    if (count == 0 || first_idx >= RAM_SIZE) return;
+    size_t last_idx = first_idx + count - 1;
+    if (last_idx >= RAM_SIZE) last_idx = RAM_SIZE - 1;
+    for (size_t p = first_idx >> RAM_PAGE_SHIFT; p <= (last_idx >> RAM_PAGE_SHIFT); p++) dirty[p] = 1;
+}
+
+inline void GuestMemory::fold_dirty() {
+    for (unsigned p = 0; p < NUM_PAGES; p++) {
+        if (dirty[p]) { touched[p] = 1; dirty[p] = 0; }
+    }
+}
+
+inline void GuestMemory::reset() {
+    for (unsigned p = 0; p < NUM_PAGES; p++) {
+        if (!dirty[p] && !touched[p]) continue;
+        memset((void*)&mem[(size_t)p * PAGE_WORDS], 0, PAGE_WORDS * 4);
+        dirty[p]   = 0;
+        touched[p] = 0;
+    }
+    base = 0;
+}
+
+inline unsigned GuestMemory::dirty_count() const {
+    unsigned n = 0;
+    for (unsigned p = 0; p < NUM_PAGES; p++) n += (dirty[p] | touched[p]);
+    return n;
+}
+
+inline void GuestMemory::snapshot(const Hart& h, GuestSnapshot& snap) {
+    fold_dirty();
+    snap.hart = h;
+    snap.hart.sim = 0;
+    snap.pages.clear();
+    snap.data.clear();
+    snap.slot.assign(NUM_PAGES, ~0u);
+    for (unsigned p = 0; p < NUM_PAGES; p++) {
+        if (!touched[p]) continue;
+        snap.slot[p] = (uint32_t)snap.pages.size();
+        snap.pages.push_back(p);
+        const uint32_t* src = (const uint32_t*)&mem[(size_t)p * PAGE_WORDS];
+        snap.data.insert(snap.data.end(), src, src + PAGE_WORDS);
+    }
+    base = &snap;
+}
+
+inline void GuestMemory::restore(Hart& h, const GuestSnapshot& snap) {
+    bool exact = (base == &snap);
+    if (!exact) fold_dirty();
+    for (unsigned p = 0; p < NUM_PAGES; p++) {
+        // Exact: only pages written since 'snap'. Otherwise anything that
+        // may differ: pages written since reset plus the saved ones.
+        bool redo = exact ? dirty[p] != 0 : (touched[p] || snap.slot[p] != ~0u);
+        if (!redo) continue;
+        void* dst = (void*)&mem[(size_t)p * PAGE_WORDS];
+        if (snap.slot[p] != ~0u) memcpy(dst, &snap.data[(size_t)snap.slot[p] * PAGE_WORDS], PAGE_WORDS * 4);
+        else                     memset(dst, 0, PAGE_WORDS * 4);
+        dirty[p] = 0;
+        if (!exact) touched[p] = (snap.slot[p] != ~0u);
+    }
+    base = &snap;
+    hart_restore(h, snap.hart);
+}
+
+inline uint32_t GuestMemory::load_elf(ElfFile& elf) {
+    uint32_t entry_pc = (unsigned)elf.load_to_mem(mem, RAM_SIZE);
+
+    // Same segment walk as load_to_mem: data + BSS both touch RAM
+    const auto ph_off = little_endian<4>(&elf.content[E_PHOFF]);
+    const auto ph_num = little_endian<2>(&elf.content[E_PHNUM]);
+    const auto* ph_table = reinterpret_cast<const Elf32_Phdr*>(&elf.content[ph_off]);
+
+    for (size_t i = 0; i < ph_num; i++) {
+        const Elf32_Phdr& ph = ph_table[i];
+        if (ph.p_type != PT_LOAD || ph.p_memsz == 0 || ph.p_paddr < DRAM_BASE) continue;
+        size_t start_idx = (ph.p_paddr - DRAM_BASE) >> 2;
+        mark_dirty(start_idx, (ph.p_memsz + 3) / 4 + 1); // +1: unaligned tail
+    }
+    return entry_pc;
+}
+
+#endif // GUEST_MEMORY_H
@@ -0,0 +1,383 @@
+#ifndef INSN_TRACE_H
+#define INSN_TRACE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <iostream>
+#include "core.h"
+
+// =======================================================
+// Binary Instruction Trace (C-Sim Only)
+// =======================================================
+// Records every retired instruction (hart_retire_hook) in a compact binary
+// stream, for full runs that would be far too slow through the CORE_TRACE
+// text logs. The sim thread encodes into fixed-size chunks of a ring; a
+// writer thread drains full chunks to the file, so disk I/O overlaps
+// simulation. The ring is lossless: a full ring stalls the sim thread.
+//
+// File layout: TraceFileHeader, then one record per instruction:
+//
+//   flags     1 byte, TRACE_* bits
+//   pc        TRACE_JUMP:  zigzag varint, pc - (previous pc + 4)
+//   instr     TRACE_INSN:  4 bytes LE; otherwise the reader's copy of the
+//                          last instruction seen at this pc (TRACE_INSN_SLOTS
+//                          direct-mapped entries, kept alike on both sides)
+//   rd value  TRACE_RD:    zigzag varint, value - last value written to rd
+//                          (rd comes from the instruction)
+//   address   TRACE_MEM:   zigzag varint, addr - previous address
+//   store     TRACE_STORE: zigzag varint of the store data / AMO operand
+//
+// Load data is the rd value (loads into x0 carry no data).
+
+static const char     TRACE_MAGIC[8]   = {'R', 'V', 'T', 'R', 'A', 'C', 'E', 0};
+static const uint32_t TRACE_VERSION    = 1;
+static const unsigned TRACE_INSN_SLOTS = 4096;
+
+enum TraceFlags {
+    TRACE_JUMP  = 0x01,
+    TRACE_INSN  = 0x02,
+    TRACE_RD    = 0x04,
+    TRACE_MEM   = 0x08, // A memory access (address follows)
+    TRACE_STORE = 0x10, // Writes memory (with TRACE_MEM)
+    TRACE_LOAD  = 0x20  // Reads memory (with TRACE_MEM)
+};
+
+struct TraceFileHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t insn_slots;
+};
+
+// Decoded record (TraceReader)
+struct TraceRecord {
+    uint32_t pc;
+    uint32_t instr;
+    uint32_t rd_val;
+    uint32_t mem_addr;
+    uint32_t mem_val;
+    uint8_t  rd;   // 0 = no writeback
+    uint8_t  mem;  // HartMemKind bits
+};
+
+// Encoder state shared by writer and reader
+struct TraceState {
+    uint32_t pc;         // Previous pc
+    uint32_t mem_addr;   // Previous memory address
+    uint32_t regs[32];   // Last value written per register
+    uint32_t insn_pc[TRACE_INSN_SLOTS];
+    uint32_t insn[TRACE_INSN_SLOTS];
+
+    void     reset() { memset(this, 0, sizeof(*this)); for (unsigned i = 0; i < TRACE_INSN_SLOTS; i++) insn_pc[i] = 1; }
+    unsigned slot(uint32_t pc) const { return (pc >> 2) & (TRACE_INSN_SLOTS - 1); }
+};
+
+class TraceWriter {
+public:
+    static const size_t   CHUNK_BYTES = 1 << 20;
+    static const unsigned RING_CHUNKS = 8;
+
+    TraceWriter();
+    ~TraceWriter();
+
+    // Creates 'path' and starts the writer thread
+    bool     open(const char* path);
+    // Records every instruction 'h' retires from now on
+    void     attach(Hart& h);
+    // Detaches from 'h', drains the ring and closes the file
+    bool     close(Hart& h);
+
+    uint64_t records() const { return count; }
+    uint64_t bytes() const   { return written + used; }
+
+private:
+    TraceState              st;
+    FILE*                   file;
+    std::vector<uint8_t>    ring;   // RING_CHUNKS * CHUNK_BYTES
+    size_t                  fill[RING_CHUNKS];
+    uint8_t*                cur;    // Chunk being encoded (sim thread)
+    size_t                  used;
+    uint64_t                head;   // Chunks handed to the writer
+    uint64_t                tail;   // Chunks written
+    bool                    done;
+    bool                    failed;
+    uint64_t                count;
+    uint64_t                written;
+    std::mutex              lock;
+    std::condition_variable ready;  // head moved / done
+    std::condition_variable freed;  // tail moved
+    std::thread             writer;
+
+    static void on_retire(void* ctx, const HartRetire& r);
+    void        record(const HartRetire& r);
+    void        put_varint(uint32_t v);
+    void        put_signed(int32_t v) { put_varint(((uint32_t)v << 1) ^ (uint32_t)(v >> 31)); }
+    void        submit();
+    void        drain();
+
+    TraceWriter(const TraceWriter&);            // Not copyable
+    TraceWriter& operator=(const TraceWriter&);
+};
+
+class TraceReader {
+public:
+    TraceReader();
+    ~TraceReader();
+
+    bool open(const char* path);
+    // Next record; false at the end of the trace (or on a damaged record)
+    bool next(TraceRecord& r);
+
+private:
+    TraceState           st;
+    FILE*                file;
+    std::vector<uint8_t> buf;
+    size_t               pos;
+    size_t               len;
+
+    bool     refill();
+    bool     get(uint8_t& b) { if (pos == len && !refill()) return false; b = buf[pos++]; return true; }
+    bool     get_varint(uint32_t& v);
+    bool     get_signed(int32_t& v);
+
+    TraceReader(const TraceReader&);            // Not copyable
+    TraceReader& operator=(const TraceReader&);
+};
+
+// --- Implementations ---
+
+inline TraceWriter::TraceWriter()
+    : file(0), cur(0), used(0), head(0), tail(0), done(false), failed(false), count(0), written(0) {}
+
+inline TraceWriter::~TraceWriter() {
+    if (!file) return;
+    {
+        std::lock_guard<std::mutex> g(lock);
+        done = true;
+    }
+    ready.notify_one();
+    writer.join();
+    fclose(file);
+}
+
+inline bool TraceWriter::open(const char* path) {
+    file = fopen(path, "wb");
+    if (!file) {
+        std::cerr << "[TRACE] Error: cannot create " << path << "\n";
+        return false;
+    }
+    TraceFileHeader hdr;
+    memcpy(hdr.magic, TRACE_MAGIC, sizeof(hdr.magic));
+    hdr.version    = TRACE_VERSION;
+    hdr.insn_slots = TRACE_INSN_SLOTS;
+    fwrite(&hdr, sizeof(hdr), 1, file);
+
+    st.reset();
+    ring.resize((size_t)RING_CHUNKS * CHUNK_BYTES);
+    cur     = &ring[0];
+    used    = 0;
+    head    = tail = 0;
+    done    = failed = false;
+    count   = 0;
+    written = sizeof(hdr);
+    writer  = std::thread(&TraceWriter::drain, this);
+    return true;
+}
+
+inline void TraceWriter::attach(Hart& h) {
+    if (file) hart_retire_hook(h, on_retire, this);
+}
+
+inline bool TraceWriter::close(Hart& h) {
+    hart_retire_hook(h, 0, 0);
+    if (!file) return false;
+    if (used) submit();
+    {
+        std::lock_guard<std::mutex> g(lock);
+        done = true;
+    }
+    ready.notify_one();
+    writer.join();
+    bool ok = !failed && fclose(file) == 0;
+    file = 0;
+    if (!ok) std::cerr << "[TRACE] Error: write failed\n";
+    return ok;
+}
+
+inline void TraceWriter::on_retire(void* ctx, const HartRetire& r) {
+    ((TraceWriter*)ctx)->record(r);
+}
+
+inline void TraceWriter::put_varint(uint32_t v) {
+    while (v >= 0x80) {
+        cur[used++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    cur[used++] = (uint8_t)v;
+}
+
+inline void TraceWriter::record(const HartRetire& r) {
+    size_t   at    = used++; // Flags, filled in last
+    uint8_t  flags = 0;
+
+    if (r.pc != st.pc + 4) {
+        flags |= TRACE_JUMP;
+        put_signed((int32_t)(r.pc - (st.pc + 4)));
+    }
+    st.pc = r.pc;
+
+    unsigned s = st.slot(r.pc);
+    if (st.insn_pc[s] != r.pc || st.insn[s] != r.instr) {
+        flags |= TRACE_INSN;
+        memcpy(&cur[used], &r.instr, 4);
+        used += 4;
+        st.insn_pc[s] = r.pc;
+        st.insn[s]    = r.instr;
+    }
+
+    if (r.rd) {
+        flags |= TRACE_RD;
+        put_signed((int32_t)(r.rd_val - st.regs[r.rd]));
+        st.regs[r.rd] = r.rd_val;
+    }
+
+    if (r.mem) {
+        flags |= TRACE_MEM;
+        put_signed((int32_t)(r.mem_addr - st.mem_addr));
+        st.mem_addr = r.mem_addr;
+        if (r.mem & HART_MEM_LOAD) flags |= TRACE_LOAD;
+        if (r.mem & HART_MEM_STORE) {
+            flags |= TRACE_STORE;
+            put_signed((int32_t)r.mem_val);
+        }
+    }
+
+    cur[at] = flags;
+    count++;
+    if (used > CHUNK_BYTES - 32) submit(); // Room for one more worst-case record
+}
+
+inline void TraceWriter::submit() {
+    std::unique_lock<std::mutex> g(lock);
+    fill[head % RING_CHUNKS] = used;
+    head++;
+    written += used;
+    ready.notify_one();
+    freed.wait(g, [this]() { return head - tail < RING_CHUNKS; });
+    cur  = &ring[(size_t)(head % RING_CHUNKS) * CHUNK_BYTES];
+    used = 0;
+}
+
+inline void TraceWriter::drain() {
+    std::unique_lock<std::mutex> g(lock);
+    while (true) {
+        ready.wait(g, [this]() { return tail != head || done; });
+        if (tail == head) return; // done, nothing left
+        const uint8_t* p = &ring[(size_t)(tail % RING_CHUNKS) * CHUNK_BYTES];
+        size_t n = fill[tail % RING_CHUNKS];
+        g.unlock();
+        bool ok = fwrite(p, 1, n, file) == n;
+        g.lock();
+        if (!ok) failed = true;
+        tail++;
+        freed.notify_one();
+    }
+}
+
+inline TraceReader::TraceReader() : file(0), pos(0), len(0) {}
+
+inline TraceReader::~TraceReader() {
+    if (file) fclose(file);
+}
+
+inline bool TraceReader::open(const char* path) {
+    file = fopen(path, "rb");
+    TraceFileHeader hdr;
+    if (!file || fread(&hdr, sizeof(hdr), 1, file) != 1 || memcmp(hdr.magic, TRACE_MAGIC, sizeof(hdr.magic)) != 0 ||
+        hdr.version != TRACE_VERSION || hdr.insn_slots != TRACE_INSN_SLOTS) {
+        std::cerr << "[TRACE] Error: " << path << " is not a readable trace\n";
+        return false;
+    }
+    st.reset();
+    buf.resize(1 << 20);
+    pos = len = 0;
+    return true;
+}
+
+inline bool TraceReader::refill() {
+    len = file ? fread(&buf[0], 1, buf.size(), file) : 0;
+    pos = 0;
+    return len > 0;
+}
+
+inline bool TraceReader::get_varint(uint32_t& v) {
+    v = 0;
+    for (unsigned shift = 0; shift < 35; shift += 7) {
+        uint8_t b;
+        if (!get(b)) return false;
+        v |= (uint32_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+inline bool TraceReader::get_signed(int32_t& v) {
+    uint32_t z;
+    if (!get_varint(z)) return false;
+    v = (int32_t)((z >> 1) ^ (0u - (z & 1)));
+    return true;
+}
+
+inline bool TraceReader::next(TraceRecord& r) {
+    uint8_t flags;
+    if (!get(flags)) return false;
+
+    int32_t d = 0;
+    if ((flags & TRACE_JUMP) && !get_signed(d)) return false;
+    r.pc  = st.pc + 4 + (uint32_t)d;
+    st.pc = r.pc;
+
+    unsigned s = st.slot(r.pc);
+    if (flags & TRACE_INSN) {
+        uint8_t b[4];
+        for (int i = 0; i < 4; i++) {
+            if (!get(b[i])) return false;
+        }
+        st.insn_pc[s] = r.pc;
+        st.insn[s]    = (uint32_t)b[0] | (uint32_t)b[1] << 8 | (uint32_t)b[2] << 16 | (uint32_t)b[3] << 24;
+    } else if (st.insn_pc[s] != r.pc) {
+        return false; // Instruction was never sent
+    }
+    r.instr = st.insn[s];
+
+    r.rd     = 0;
+    r.rd_val = 0;
+    if (flags & TRACE_RD) {
+        if (!get_signed(d)) return false;
+        r.rd     = (uint8_t)((r.instr >> 7) & 0x1F);
+        r.rd_val = st.regs[r.rd] + (uint32_t)d;
+        st.regs[r.rd] = r.rd_val;
+    }
+
+    r.mem      = 0;
+    r.mem_addr = 0;
+    r.mem_val  = 0;
+    if (flags & TRACE_MEM) {
+        if (!get_signed(d)) return false;
+        r.mem_addr  = st.mem_addr + (uint32_t)d;
+        st.mem_addr = r.mem_addr;
+        if (flags & TRACE_LOAD) r.mem |= HART_MEM_LOAD;
+        if (flags & TRACE_STORE) {
+            if (!get_signed(d)) return false;
+            r.mem     |= HART_MEM_STORE;
+            r.mem_val  = (uint32_t)d;
+        }
+    }
+    return true;
+}
+
+#endif // INSN_TRACE_H
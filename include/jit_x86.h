@@ -0,0 +1,57 @@
+#ifndef JIT_X86_H
+#define JIT_X86_H
+
+#include <cstdint>
+
+// =======================================================
+// x86-64 Dynamic Binary Translator (C-Sim Only)
+// =======================================================
+// Translates a straight-line run of decoded RV32IM instructions into native
+// code. The core keeps ownership of all architectural state: translated code
+// works directly on the register file and calls back into the core for
+// loads, stores and M-extension ops, so riscv_step stays the reference.
+
+// Decoded instruction handed to the translator (plain integers, no ap_int)
+struct JitInsn {
+    uint32_t instr;
+    uint8_t  opcode;
+    uint8_t  rd;
+    uint8_t  rs1;
+    uint8_t  rs2;
+    uint8_t  funct3;
+    uint8_t  funct7;
+    int32_t  imm;
+};
+
+// Core callbacks. 'ctx' is passed through untouched.
+//   load : returns the loaded value in bits [31:0]; bit 32 set = not handled,
+//          leave the instruction to the interpreter
+//   store: 0 = done, 1 = not handled, 2 = done but code was modified (exit)
+//   alu  : result of an R-type instruction the translator does not inline
+struct JitHelpers {
+    uint64_t (*load)(void* ctx, uint32_t addr, uint32_t funct3);
+    int      (*store)(void* ctx, uint32_t addr, uint32_t val, uint32_t funct3);
+    int32_t  (*alu)(void* ctx, uint32_t instr, int32_t a, int32_t b);
+};
+
+// Translated code. Returns (retired << 32) | next_pc.
+typedef uint64_t (*JitFn)(int32_t* regs, void* ctx);
+
+// Executable code buffer. Each hart owns one; it is not thread-safe.
+struct JitCache;
+
+// True when the host can run translated code
+bool      jit_available();
+
+// Allocates / frees a code buffer (0 if the host cannot run translated code)
+JitCache* jit_create();
+void      jit_destroy(JitCache* c);
+
+// Drops every translation in 'c' (called when the block cache is flushed)
+void      jit_reset(JitCache* c);
+
+// Translates the longest supported prefix of 'insns' (entry at 'pc') into 'c'.
+// Returns 0 if nothing could be translated or the code buffer is full.
+JitFn     jit_compile(JitCache* c, const JitInsn* insns, unsigned count, uint32_t pc, const JitHelpers& h);
+
+#endif // JIT_X86_H
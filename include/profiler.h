@@ -0,0 +1,218 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include "elf.h"
+#include "elfFile.h"
+#include "core.h"
+
+// =======================================================
+// Execution Profile Report (C-Sim Only)
+// =======================================================
+// Turns the exact per-PC counts of hart_profile() into a ranked per-function
+// report and a collapsed-stack file ("frame;frame count" lines) for
+// flamegraph.pl or speedscope. Symbols come from the program's ELF, or from
+// a System.map for raw images such as the Linux kernel.
+
+struct ProfileSymbol {
+    uint32_t    addr;
+    uint32_t    size; // 0 = unknown, runs up to the next symbol
+    std::string name;
+};
+
+struct ProfileEntry {
+    std::string name;
+    uint32_t    addr;
+    uint64_t    insns;
+    uint64_t    cycles;
+};
+
+// Code symbols of 'elf' (functions and text labels)
+std::vector<ProfileSymbol> profile_symbols_from_elf(const ElfFile& elf);
+
+// Text symbols of a System.map ("addr type name" per line)
+std::vector<ProfileSymbol> profile_symbols_from_map(const char* path);
+
+// Sorts 'syms' by address, keeping one symbol per address
+void profile_sort_symbols(std::vector<ProfileSymbol>& syms);
+
+// Index of the symbol containing 'pc' in sorted 'syms', or syms.size()
+size_t profile_find(const std::vector<ProfileSymbol>& syms, uint32_t pc);
+
+// Per-function totals of 'h', hottest first. PCs outside every symbol are
+// reported as "[unknown]"; without any symbols each PC is its own entry.
+std::vector<ProfileEntry> profile_collect(const Hart& h, std::vector<ProfileSymbol> syms);
+
+// Ranked text report of the 'top' hottest functions (0 = all)
+void profile_print(const std::vector<ProfileEntry>& funcs, std::ostream& os, unsigned top);
+
+// Collapsed-stack output, weighted by cycles
+bool profile_write_folded(const std::vector<ProfileEntry>& funcs, const char* path);
+
+// --- Implementations ---
+
+inline std::vector<ProfileSymbol> profile_symbols_from_elf(const ElfFile& elf) {
+    std::vector<ProfileSymbol> syms;
+    for (const auto& s : elf.symbols) {
+        if (s.type != STT_FUNC && s.type != STT_NOTYPE) continue;
+        if (s.name.empty() || s.section == SHN_UNDEF || s.section >= SHN_LORESERVE) continue;
+        if (s.name[0] == '$' || s.name.compare(0, 2, ".L") == 0) continue; // Mapping symbols, local labels
+        if (s.section >= elf.sectionTable.size()) continue;
+        if (elf.sectionTable[s.section].type != SHT_PROGBITS) continue;    // Skip .bss and friends
+        ProfileSymbol p;
+        p.addr = s.value;
+        p.size = s.size;
+        p.name = s.name;
+        syms.push_back(p);
+    }
+    return syms;
+}
+
+inline std::vector<ProfileSymbol> profile_symbols_from_map(const char* path) {
+    std::vector<ProfileSymbol> syms;
+    std::ifstream f(path);
+    if (!f) {
+        std::cerr << "[PROF] Error: cannot open " << path << "\n";
+        return syms;
+    }
+    std::string line;
+    while (std::getline(f, line)) {
+        std::istringstream ls(line);
+        std::string addr, type, name;
+        if (!(ls >> addr >> type >> name)) continue;
+        if (type != "T" && type != "t" && type != "W" && type != "w") continue;
+        ProfileSymbol p;
+        p.addr = (uint32_t)strtoul(addr.c_str(), 0, 16);
+        p.size = 0;
+        p.name = name;
+        syms.push_back(p);
+    }
+    return syms;
+}
+
+inline void profile_sort_symbols(std::vector<ProfileSymbol>& syms) {
+    // Of several symbols at one address prefer a sized one
+    std::sort(syms.begin(), syms.end(), [](const ProfileSymbol& a, const ProfileSymbol& b) {
+        return a.addr != b.addr ? a.addr < b.addr : a.size < b.size;
+    });
+    std::vector<ProfileSymbol> uniq;
+    for (const auto& s : syms) {
+        if (!uniq.empty() && uniq.back().addr == s.addr) uniq.back() = s;
+        else                                             uniq.push_back(s);
+    }
+    syms.swap(uniq);
+}
+
+inline size_t profile_find(const std::vector<ProfileSymbol>& syms, uint32_t pc) {
+    // Last symbol at or below pc
+    size_t lo = 0, hi = syms.size();
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (syms[mid].addr <= pc) lo = mid + 1;
+        else                      hi = mid;
+    }
+    if (lo == 0) return syms.size();
+    const ProfileSymbol& s = syms[lo - 1];
+    return (s.size == 0 || pc < s.addr + s.size) ? lo - 1 : syms.size();
+}
+
+struct ProfileCollect {
+    const std::vector<ProfileSymbol>* syms;
+    std::vector<ProfileEntry>         funcs;   // One per symbol, plus [unknown] last
+};
+
+inline void profile_collect_pc(void* ctx, uint32_t pc, uint64_t insns, uint64_t cycles) {
+    ProfileCollect& c = *(ProfileCollect*)ctx;
+    const std::vector<ProfileSymbol>& syms = *c.syms;
+
+    if (syms.empty()) {
+        char name[16];
+        snprintf(name, sizeof(name), "0x%08x", (unsigned)pc);
+        ProfileEntry e;
+        e.name   = name;
+        e.addr   = 0;
+        e.insns  = insns;
+        e.cycles = cycles;
+        c.funcs.push_back(e);
+        return;
+    }
+
+    size_t slot = profile_find(syms, pc); // syms.size() = [unknown]
+    c.funcs[slot].insns  += insns;
+    c.funcs[slot].cycles += cycles;
+}
+
+inline std::vector<ProfileEntry> profile_collect(const Hart& h, std::vector<ProfileSymbol> syms) {
+    profile_sort_symbols(syms);
+
+    ProfileCollect c;
+    c.syms = &syms;
+    c.funcs.resize(syms.empty() ? 0 : syms.size() + 1);
+    for (size_t i = 0; i < syms.size(); i++) {
+        c.funcs[i].name = syms[i].name;
+        c.funcs[i].addr = syms[i].addr;
+    }
+    if (!c.funcs.empty()) {
+        c.funcs.back().name = "[unknown]";
+        c.funcs.back().addr = 0;
+    }
+    for (auto& f : c.funcs) f.insns = f.cycles = 0;
+
+    hart_profile_visit(h, profile_collect_pc, &c);
+
+    std::vector<ProfileEntry> out;
+    for (const auto& f : c.funcs) {
+        if (f.insns || f.cycles) out.push_back(f);
+    }
+    std::sort(out.begin(), out.end(), [](const ProfileEntry& a, const ProfileEntry& b) {
+        return a.cycles > b.cycles;
+    });
+    return out;
+}
+
+inline void profile_print(const std::vector<ProfileEntry>& funcs, std::ostream& os, unsigned top) {
+    uint64_t total_cycles = 0, total_insns = 0;
+    for (const auto& f : funcs) {
+        total_cycles += f.cycles;
+        total_insns  += f.insns;
+    }
+
+    os << "\n==================================================================\n";
+    os << "  PROFILE: " << std::dec << total_cycles << " cycles, " << total_insns << " instructions\n";
+    os << "==================================================================\n";
+    os << std::right << std::setw(7) << "cycles%" << std::setw(14) << "cycles"
+       << std::setw(14) << "insns" << "  " << std::left << "function\n";
+
+    unsigned n = 0;
+    for (const auto& f : funcs) {
+        if (top && n++ == top) break;
+        double pct = total_cycles ? 100.0 * (double)f.cycles / (double)total_cycles : 0.0;
+        os << std::right << std::fixed << std::setprecision(2) << std::setw(6) << pct << "%"
+           << std::setw(14) << f.cycles << std::setw(14) << f.insns << "  " << std::left << f.name;
+        if (f.addr) os << " (0x" << std::hex << f.addr << std::dec << ")";
+        os << "\n";
+    }
+    os << std::right;
+}
+
+inline bool profile_write_folded(const std::vector<ProfileEntry>& funcs, const char* path) {
+    std::ofstream f(path);
+    if (!f) {
+        std::cerr << "[PROF] Error: cannot create " << path << "\n";
+        return false;
+    }
+    for (const auto& e : funcs) {
+        if (e.cycles) f << e.name << " " << e.cycles << "\n";
+    }
+    return (bool)f;
+}
+
+#endif // PROFILER_H
@@ -0,0 +1,600 @@
+#ifndef REF_ISS_H
+#define REF_ISS_H
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include "core.h"
+
+// =======================================================
+// Reference ISS and Lockstep Checker (C-Sim Only)
+// =======================================================
+// RefIss is a plain RV32IMA + Zicsr interpreter written from the ISA
+// manual. It shares nothing with core.cpp except the platform memory map
+// (RAM aliased every 128 MB, UART at 0x10000000, CLINT, the HTIF fromhost
+// ack). It keeps its own registers, CSRs and a sparse copy of RAM.
+//
+// LockstepChecker steps it from hart_retire_hook(). For every retired
+// instruction it compares pc, instruction, rd value, memory address, store
+// data and the RAM words written. Every 'interval' instructions (and at
+// finish) it also compares the register file, trap CSRs and every page
+// the reference wrote. The first divergence stops the core (hart_stop) and
+// prints both states.
+//
+// Values the platform does not model are taken from the core: MMIO loads
+// (UART, mtime) and mcycle reads. The timer interrupt is taken when the
+// core's next pc says so, provided the reference agrees it was enabled and
+// due at the core's mcycle.
+
+class RefIss {
+public:
+    static const unsigned PAGE_WORDS = 1u << RAM_PAGE_SHIFT;
+    static const unsigned NUM_PAGES  = RAM_SIZE / PAGE_WORDS;
+
+    uint32_t pc;
+    uint32_t x[32];
+    uint32_t mstatus, mie, mip, mtvec, mepc, mcause, mtval, mscratch;
+    uint32_t medeleg, mideleg, mcountinhibit, satp;
+    uint64_t minstret;
+    uint64_t mtimecmp;
+    bool     lr_valid;
+    uint32_t lr_addr;
+
+    RefIss();
+    ~RefIss();
+
+    // Copies the architectural state of 'h' and every non-zero page of 'ram'
+    void     load(const Hart& h, volatile uint32_t* ram);
+
+    // Executes the instruction at pc. 'input' is used where the platform
+    // has no model (MMIO loads, mcycle reads); 'mcycle' is the current time.
+    // Fills 'out' the way hart_retire_hook reports the same instruction.
+    void     step(uint32_t input, uint64_t mcycle, HartRetire& out);
+
+    bool     irq_due(uint64_t mcycle) const;
+    void     take_irq();
+
+    uint32_t word(uint32_t idx) const;
+    bool     written(unsigned page) const { return dirty[page] != 0; }
+    void     clear_written()              { std::fill(dirty.begin(), dirty.end(), 0); }
+
+private:
+    std::vector<uint32_t*> pages; // Null = all zero
+    std::vector<uint8_t>   dirty; // Written since clear_written()
+
+    static uint32_t idx(uint32_t addr) { return (addr & 0x07FFFFFF) >> 2; }
+    void     set_word(uint32_t idx, uint32_t v);
+    uint32_t load_bytes(uint32_t addr, unsigned n) const;
+    void     store_bytes(uint32_t addr, uint32_t v, unsigned n);
+    uint32_t csr_get(unsigned csr, uint32_t input, uint64_t mcycle) const;
+    void     csr_set(unsigned csr, uint32_t v);
+    void     trap(uint32_t cause, uint32_t epc);
+
+    RefIss(const RefIss&);            // Not copyable
+    RefIss& operator=(const RefIss&);
+};
+
+class LockstepChecker {
+public:
+    // interval: retired instructions between full-state comparisons
+    explicit LockstepChecker(uint64_t interval = 1000000);
+
+    // Loads the reference from 'h' and 'ram' and starts checking
+    void     attach(Hart& h, volatile uint32_t* ram);
+    // Final full-state comparison; detaches from 'h'. True if no divergence.
+    bool     finish(Hart& h);
+
+    bool     ok() const       { return !failed; }
+    uint64_t checked() const  { return count; }
+
+private:
+    static const unsigned HISTORY = 16;
+
+    RefIss             ref;
+    Hart*              dut;
+    volatile uint32_t* ram;
+    uint64_t           interval;
+    uint64_t           count;
+    bool               failed;
+    HartRetire         history[HISTORY]; // Last instructions the core retired
+
+    static void on_retire(void* ctx, const HartRetire& r);
+    void        check(const HartRetire& r);
+    bool        check_state(bool all_pages);
+    void        report(const char* what, const HartRetire* core, const HartRetire* ref_r);
+};
+
+// --- Implementations ---
+
+inline RefIss::RefIss() : pages(NUM_PAGES, (uint32_t*)0), dirty(NUM_PAGES, 0) {}
+
+inline RefIss::~RefIss() {
+    for (auto p : pages) delete[] p;
+}
+
+inline uint32_t RefIss::word(uint32_t i) const {
+    const uint32_t* p = pages[i / PAGE_WORDS];
+    return p ? p[i % PAGE_WORDS] : 0;
+}
+
+inline void RefIss::set_word(uint32_t i, uint32_t v) {
+    uint32_t*& p = pages[i / PAGE_WORDS];
+    if (!p) {
+        if (v == 0) return;
+        p = new uint32_t[PAGE_WORDS]();
+    }
+    p[i % PAGE_WORDS] = v;
+    dirty[i / PAGE_WORDS] = 1;
+}
+
+inline void RefIss::load(const Hart& h, volatile uint32_t* ram) {
+    for (unsigned p = 0; p < NUM_PAGES; p++) {
+        delete[] pages[p];
+        pages[p] = 0;
+        const volatile uint32_t* src = &ram[(size_t)p * PAGE_WORDS];
+        unsigned i = 0;
+        while (i < PAGE_WORDS && src[i] == 0) i++;
+        if (i == PAGE_WORDS) continue;
+        pages[p] = new uint32_t[PAGE_WORDS];
+        for (i = 0; i < PAGE_WORDS; i++) pages[p][i] = src[i];
+    }
+    clear_written();
+
+    pc = (uint32_t)(uword_t)h.pc;
+    for (int i = 0; i < 32; i++) x[i] = (uint32_t)(uword_t)h.regfile[i];
+    x[0]          = 0;
+    mstatus       = (uint32_t)(uword_t)h.csr_mstatus;
+    mie           = (uint32_t)(uword_t)h.csr_mie;
+    mip           = (uint32_t)(uword_t)h.csr_mip;
+    mtvec         = (uint32_t)(uword_t)h.csr_mtvec;
+    mepc          = (uint32_t)(uword_t)h.csr_mepc;
+    mcause        = (uint32_t)(uword_t)h.csr_mcause;
+    mtval         = (uint32_t)(uword_t)h.csr_mtval;
+    mscratch      = (uint32_t)(uword_t)h.csr_mscratch;
+    medeleg       = (uint32_t)(uword_t)h.csr_medeleg;
+    mideleg       = (uint32_t)(uword_t)h.csr_mideleg;
+    mcountinhibit = (uint32_t)(uword_t)h.csr_mcountinhibit;
+    satp          = (uint32_t)(uword_t)h.csr_satp;
+    minstret      = (uint64_t)h.csr_minstret;
+    mtimecmp      = (uint64_t)h.mtimecmp;
+    lr_valid      = h.lr_valid;
+    lr_addr       = (uint32_t)(uword_t)h.lr_addr;
+}
+
+inline uint32_t RefIss::load_bytes(uint32_t addr, unsigned n) const {
+    uint32_t v = 0;
+    for (unsigned b = 0; b < n; b++) {
+        uint32_t a = addr + b;
+        v |= ((word(idx(a)) >> ((a & 3) * 8)) & 0xFF) << (8 * b);
+    }
+    return v;
+}
+
+inline void RefIss::store_bytes(uint32_t addr, uint32_t v, unsigned n) {
+    for (unsigned b = 0; b < n; b++) {
+        uint32_t a = addr + b;
+        unsigned sh = (a & 3) * 8;
+        uint32_t w = word(idx(a));
+        set_word(idx(a), (w & ~(0xFFu << sh)) | (((v >> (8 * b)) & 0xFF) << sh));
+    }
+}
+
+inline uint32_t RefIss::csr_get(unsigned csr, uint32_t input, uint64_t mcycle) const {
+    switch (csr) {
+        case 0x301: return 0x40001101;             // misa: RV32IMA
+        case 0x300: return mstatus;
+        case 0x302: return medeleg;
+        case 0x303: return mideleg;
+        case 0x304: return mie;
+        case 0x305: return mtvec;
+        case 0x320: return mcountinhibit;
+        case 0x340: return mscratch;
+        case 0x341: return mepc;
+        case 0x342: return mcause;
+        case 0x343: return mtval;
+        case 0x344: return (mip & ~0x80u) | (mcycle >= mtimecmp ? 0x80u : 0); // MTIP
+        case 0xB00: case 0xB80: case 0xC00: case 0xC80:
+            return input;                          // mcycle: core timing
+        case 0xB02: case 0xC02: return (uint32_t)minstret;
+        case 0xB82: case 0xC82: return (uint32_t)(minstret >> 32);
+        case 0x180: return satp;
+        default:    return 0;                      // IDs and unimplemented CSRs read 0
+    }
+}
+
+inline void RefIss::csr_set(unsigned csr, uint32_t v) {
+    switch (csr) {
+        case 0x300: mstatus = v; break;
+        case 0x302: medeleg = v; break;
+        case 0x303: mideleg = v; break;
+        case 0x304: mie = v; break;
+        case 0x305: mtvec = v; break;
+        case 0x320: mcountinhibit = v; break;
+        case 0x340: mscratch = v; break;
+        case 0x341: mepc = v; break;
+        case 0x342: mcause = v; break;
+        case 0x343: mtval = v; break;
+        case 0x344: mip = v; break;
+        case 0x180: satp = v; break;
+        default: break;                            // Read-only: ignored
+    }
+}
+
+inline void RefIss::trap(uint32_t cause, uint32_t epc) {
+    // MPIE = MIE, MIE = 0
+    mstatus = (mstatus & ~0x80u) | ((mstatus & 0x8u) << 4);
+    mstatus &= ~0x8u;
+    mepc   = epc;
+    mcause = cause;
+}
+
+inline bool RefIss::irq_due(uint64_t mcycle) const {
+    return ((mstatus >> 3) & 1) && ((mie >> 7) & 1) && mcycle >= mtimecmp;
+}
+
+inline void RefIss::take_irq() {
+    trap(0x80000007, pc);
+    pc = mtvec;
+}
+
+inline void RefIss::step(uint32_t input, uint64_t mcycle, HartRetire& out) {
+    uint32_t in  = word(idx(pc));
+    uint32_t op  = in & 0x7F;
+    uint32_t rd  = (in >> 7) & 0x1F;
+    uint32_t f3  = (in >> 12) & 0x7;
+    uint32_t rs1 = (in >> 15) & 0x1F;
+    uint32_t rs2 = (in >> 20) & 0x1F;
+    uint32_t f7  = in >> 25;
+    uint32_t a   = x[rs1];
+    uint32_t b   = x[rs2];
+
+    int32_t  imm_i = (int32_t)in >> 20;
+    int32_t  imm_s = ((int32_t)in >> 25 << 5) | (int32_t)((in >> 7) & 0x1F);
+    int32_t  imm_b = ((int32_t)in >> 31 << 12) | (int32_t)(((in >> 7) & 1) << 11) |
+                     (int32_t)(((in >> 25) & 0x3F) << 5) | (int32_t)(((in >> 8) & 0xF) << 1);
+    int32_t  imm_j = ((int32_t)in >> 31 << 20) | (int32_t)(in & 0xFF000) |
+                     (int32_t)(((in >> 20) & 1) << 11) | (int32_t)(((in >> 21) & 0x3FF) << 1);
+
+    out.pc       = pc;
+    out.instr    = in;
+    out.rd       = 0;
+    out.rd_val   = 0;
+    out.mem      = 0;
+    out.mem_addr = 0;
+    out.mem_val  = 0;
+
+    uint32_t next = pc + 4;
+    bool     wb   = false;  // Writes rd
+    uint32_t res  = 0;
+    bool     ill  = false;  // Illegal instruction
+
+    switch (op) {
+        case 0x37: wb = true; res = in & 0xFFFFF000; break;               // LUI
+        case 0x17: wb = true; res = pc + (in & 0xFFFFF000); break;        // AUIPC
+        case 0x6F: wb = true; res = pc + 4; next = pc + imm_j; break;      // JAL
+        case 0x67:                                                        // JALR
+            if (f3 != 0) { ill = true; break; }
+            wb = true; res = pc + 4; next = (a + imm_i) & ~1u;
+            break;
+        case 0x63: {                                                      // Branches
+            bool t;
+            switch (f3) {
+                case 0: t = a == b; break;
+                case 1: t = a != b; break;
+                case 4: t = (int32_t)a <  (int32_t)b; break;
+                case 5: t = (int32_t)a >= (int32_t)b; break;
+                case 6: t = a <  b; break;
+                case 7: t = a >= b; break;
+                default: ill = true; t = false; break;
+            }
+            if (t) next = pc + imm_b;
+            break;
+        }
+        case 0x03: {                                                      // Loads
+            uint32_t ea = a + imm_i;
+            out.mem = HART_MEM_LOAD;
+            out.mem_addr = ea;
+            uint32_t ph = ea & 0x07FFFFFF;
+            uint32_t v;
+            unsigned n = (f3 & 3) == 0 ? 1 : (f3 & 3) == 1 ? 2 : 4;
+            if (f3 == 3 || f3 > 5)                              { ill = true; out.mem = 0; break; }
+            if ((ea & 0xFFFFF000) == 0x10000000 || ph == 0x200BFF8 || ph == 0x200BFFC) {
+                v = input;                                        // UART, mtime
+            } else if (ph == 0x2004000) {
+                v = (uint32_t)mtimecmp;
+            } else if (ph == 0x2004004) {
+                v = (uint32_t)(mtimecmp >> 32);
+            } else {
+                v = load_bytes(ea, n);
+                if (f3 == 0) v = (uint32_t)(int32_t)(int8_t)v;
+                if (f3 == 1) v = (uint32_t)(int32_t)(int16_t)v;
+            }
+            wb = true; res = v;
+            break;
+        }
+        case 0x23: {                                                      // Stores
+            if (f3 > 2) { ill = true; break; }
+            uint32_t ea = a + imm_s;
+            uint32_t ph = ea & 0x07FFFFFF;
+            out.mem      = HART_MEM_STORE;
+            out.mem_addr = ea;
+            out.mem_val  = b;
+            lr_valid     = false;
+            if ((ea & 0xFFFFF000) == 0x10000000) break;                   // UART: device
+            if (ph == 0x2004000) { mtimecmp = (mtimecmp & 0xFFFFFFFF00000000ULL) | b; break; }
+            if (ph == 0x2004004) { mtimecmp = (mtimecmp & 0xFFFFFFFFULL) | ((uint64_t)b << 32); break; }
+            store_bytes(ea, b, 1u << f3);
+            if (ph == 0x1000) set_word(idx(ea) + 16, 1);                  // HTIF: fromhost ack
+            break;
+        }
+        case 0x13: {                                                      // OP-IMM
+            uint32_t sh = imm_i & 0x1F;
+            wb = true;
+            switch (f3) {
+                case 0: res = a + imm_i; break;
+                case 1: res = a << sh; break;
+                case 2: res = (int32_t)a < imm_i; break;
+                case 3: res = a < (uint32_t)imm_i; break;
+                case 4: res = a ^ imm_i; break;
+                case 5: res = (in >> 30) & 1 ? (uint32_t)((int32_t)a >> sh) : a >> sh; break;
+                case 6: res = a | imm_i; break;
+                case 7: res = a & imm_i; break;
+            }
+            break;
+        }
+        case 0x33: {                                                      // OP
+            wb = true;
+            if (f7 == 0x01) {                                             // M
+                int64_t  sa = (int32_t)a, sb = (int32_t)b;
+                uint64_t ua = a, ub = b;
+                switch (f3) {
+                    case 0: res = a * b; break;
+                    case 1: res = (uint32_t)((uint64_t)(sa * sb) >> 32); break;
+                    case 2: res = (uint32_t)((uint64_t)(sa * (int64_t)ub) >> 32); break;
+                    case 3: res = (uint32_t)((ua * ub) >> 32); break;
+                    case 4: res = b == 0 ? 0xFFFFFFFF : (a == 0x80000000 && b == 0xFFFFFFFF) ? a : (uint32_t)((int32_t)a / (int32_t)b); break;
+                    case 5: res = b == 0 ? 0xFFFFFFFF : a / b; break;
+                    case 6: res = b == 0 ? a : (a == 0x80000000 && b == 0xFFFFFFFF) ? 0 : (uint32_t)((int32_t)a % (int32_t)b); break;
+                    case 7: res = b == 0 ? a : a % b; break;
+                }
+            } else if (f7 == 0x00 || (f7 == 0x20 && (f3 == 0 || f3 == 5))) {
+                uint32_t sh = b & 0x1F;
+                switch (f3) {
+                    case 0: res = f7 ? a - b : a + b; break;
+                    case 1: res = a << sh; break;
+                    case 2: res = (int32_t)a < (int32_t)b; break;
+                    case 3: res = a < b; break;
+                    case 4: res = a ^ b; break;
+                    case 5: res = f7 ? (uint32_t)((int32_t)a >> sh) : a >> sh; break;
+                    case 6: res = a | b; break;
+                    case 7: res = a & b; break;
+                }
+            } else {
+                ill = true;
+            }
+            break;
+        }
+        case 0x2F: {                                                      // A (word only)
+            if (f3 != 2) { ill = true; break; }
+            uint32_t f5  = f7 >> 2;
+            uint32_t old = word(idx(a));
+            uint32_t nv  = 0;
+            bool     st  = true;
+            out.mem      = HART_MEM_LOAD | HART_MEM_STORE;
+            out.mem_addr = a;
+            out.mem_val  = b;
+            wb = true;
+            switch (f5) {
+                case 0x02: res = old; st = false; lr_valid = true; lr_addr = a; break; // LR.W
+                case 0x03:                                                             // SC.W
+                    st  = lr_valid && lr_addr == a;
+                    res = st ? 0 : 1;
+                    nv  = b;
+                    lr_valid = false;
+                    break;
+                case 0x01: res = old; nv = b; break;                                   // AMOSWAP
+                case 0x00: res = old; nv = old + b; break;                             // AMOADD
+                case 0x04: res = old; nv = old ^ b; break;                             // AMOXOR
+                case 0x0C: res = old; nv = old & b; break;                             // AMOAND
+                case 0x08: res = old; nv = old | b; break;                             // AMOOR
+                case 0x10: res = old; nv = (int32_t)old < (int32_t)b ? old : b; break; // AMOMIN
+                case 0x14: res = old; nv = (int32_t)old > (int32_t)b ? old : b; break; // AMOMAX
+                case 0x18: res = old; nv = old < b ? old : b; break;                   // AMOMINU
+                case 0x1C: res = old; nv = old > b ? old : b; break;                   // AMOMAXU
+                default: ill = true; out.mem = 0; wb = false; st = false; break;
+            }
+            if (st) {
+                set_word(idx(a), nv);
+                lr_valid = false;
+            }
+            break;
+        }
+        case 0x0F: break;                                                 // FENCE, FENCE.I
+        case 0x73: {                                                      // SYSTEM
+            uint32_t csr = in >> 20;
+            if (f3 == 0) {
+                if      (in == 0x00000073) { trap(11, pc); next = mtvec; }  // ECALL
+                else if (in == 0x00100073) { trap(3, pc);  next = mtvec; }  // EBREAK
+                else if (in == 0x30200073) {                              // MRET
+                    // MIE = MPIE, MPIE = 1
+                    mstatus = (mstatus & ~0x8u) | ((mstatus >> 4) & 0x8u);
+                    mstatus |= 0x80u;
+                    next = mepc;
+                }
+                else if (in == 0x10500073) {}                             // WFI
+                else ill = true;
+                break;
+            }
+            if (f3 == 4) { ill = true; break; }
+            uint32_t old = csr_get(csr, input, mcycle);
+            uint32_t src = (f3 & 4) ? rs1 : a;                            // CSRR*I: zimm
+            bool     wr  = (f3 & 3) == 1 || rs1 != 0;
+            if (wr) {
+                switch (f3 & 3) {
+                    case 1: csr_set(csr, src); break;
+                    case 2: csr_set(csr, old | src); break;
+                    case 3: csr_set(csr, old & ~src); break;
+                }
+            }
+            wb = true; res = old;
+            break;
+        }
+        default: ill = true; break;
+    }
+
+    if (ill) {
+        trap(2, pc);
+        mtval = in;
+        out.mem = 0;
+        wb = false;
+        next = mtvec;
+    }
+    if (wb && rd != 0) {
+        x[rd]      = res;
+        out.rd     = (uint8_t)rd;
+        out.rd_val = res;
+    }
+    pc = next;
+    minstret++;
+}
+
+inline LockstepChecker::LockstepChecker(uint64_t interval)
+    : dut(0), ram(0), interval(interval), count(0), failed(false) {
+    memset(history, 0, sizeof(history));
+}
+
+inline void LockstepChecker::attach(Hart& h, volatile uint32_t* r) {
+    dut    = &h;
+    ram    = r;
+    count  = 0;
+    failed = false;
+    ref.load(h, r);
+    hart_retire_hook(h, on_retire, this);
+}
+
+inline bool LockstepChecker::finish(Hart& h) {
+    hart_retire_hook(h, 0, 0);
+    if (!failed && dut) check_state(true); // All of RAM: also catches stray core writes
+    dut = 0;
+    return !failed;
+}
+
+inline void LockstepChecker::on_retire(void* ctx, const HartRetire& r) {
+    ((LockstepChecker*)ctx)->check(r);
+}
+
+inline void LockstepChecker::check(const HartRetire& r) {
+    if (failed) return;
+    uint64_t now = (uint64_t)dut->csr_mcycle;
+
+    // The core took the timer interrupt before this instruction
+    if (r.pc != ref.pc && ref.irq_due(now)) ref.take_irq();
+
+    HartRetire e;
+    ref.step(r.rd_val, now, e);
+    count++;
+    history[count % HISTORY] = r;
+
+    const char* what = 0;
+    if      (r.pc != e.pc)                                          what = "pc";
+    else if (r.instr != e.instr)                                    what = "instruction";
+    else if (r.rd != e.rd || r.rd_val != e.rd_val)                  what = "rd writeback";
+    else if (r.mem != e.mem || (e.mem && r.mem_addr != e.mem_addr)) what = "memory address";
+    else if ((e.mem & HART_MEM_STORE) && r.mem_val != e.mem_val)    what = "store data";
+    else if (e.mem & HART_MEM_STORE) {
+        // The RAM words the store covers (MMIO has no RAM side)
+        uint32_t ph = e.mem_addr & 0x07FFFFFF;
+        bool mmio = (e.mem_addr & 0xFFFFF000) == 0x10000000 || ph == 0x2004000 || ph == 0x2004004;
+        for (uint32_t k = ph >> 2; !mmio && k <= (ph >> 2) + 1 && k < RAM_SIZE && !what; k++) {
+            uint32_t c = hart_mem_read(*dut, ram, k);
+            if (c == ref.word(k)) continue;
+            std::cout << "[LOCKSTEP] RAM 0x" << std::hex << (DRAM_BASE + 4 * k) << ": core 0x" << c
+                      << ", reference 0x" << ref.word(k) << std::dec << "\n";
+            what = "memory contents";
+        }
+    }
+
+    if (what) {
+        report(what, &r, &e);
+        return;
+    }
+    if (interval && count % interval == 0) check_state(false);
+}
+
+inline bool LockstepChecker::check_state(bool all_pages) {
+    const char* what = 0;
+    for (int i = 1; i < 32 && !what; i++) {
+        if ((uint32_t)(uword_t)dut->regfile[i] != ref.x[i]) what = "register file";
+    }
+    if (!what && ((uint32_t)(uword_t)dut->csr_mstatus != ref.mstatus || (uint32_t)(uword_t)dut->csr_mepc != ref.mepc ||
+                  (uint32_t)(uword_t)dut->csr_mcause != ref.mcause || (uint32_t)(uword_t)dut->csr_mtvec != ref.mtvec ||
+                  (uint32_t)(uword_t)dut->csr_mie != ref.mie || (uint64_t)dut->mtimecmp != ref.mtimecmp)) {
+        what = "trap CSRs";
+    }
+    for (unsigned p = 0; p < RefIss::NUM_PAGES && !what; p++) {
+        if (!all_pages && !ref.written(p)) continue;
+        for (unsigned i = 0; i < RefIss::PAGE_WORDS; i++) {
+            uint32_t k = p * RefIss::PAGE_WORDS + i;
+            uint32_t c = hart_mem_read(*dut, ram, k);
+            if (c != ref.word(k)) {
+                std::cout << "[LOCKSTEP] RAM 0x" << std::hex << (DRAM_BASE + 4 * k) << ": core 0x" << c
+                          << ", reference 0x" << ref.word(k) << std::dec << "\n";
+                what = "memory contents";
+                break;
+            }
+        }
+    }
+    ref.clear_written();
+    if (what) report(what, 0, 0);
+    return !what;
+}
+
+inline void LockstepChecker::report(const char* what, const HartRetire* core, const HartRetire* ref_r) {
+    failed = true;
+    if (dut) hart_stop(*dut);
+
+    std::ostream& os = std::cout;
+    os << std::hex << std::setfill('0');
+    os << "\n==================================================================\n";
+    os << "  LOCKSTEP DIVERGENCE: " << what << " (instruction " << std::dec << count
+       << ", cycle " << (uint64_t)dut->csr_mcycle << std::hex << ")\n";
+    os << "==================================================================\n";
+
+    os << "Last instructions of the core (oldest first):\n";
+    for (unsigned k = HISTORY; k-- > 0; ) {
+        if (count <= k) continue;
+        const HartRetire& h = history[(count - k) % HISTORY];
+        os << "  0x" << std::setw(8) << h.pc << "  " << std::setw(8) << h.instr;
+        if (h.rd) os << "  x" << std::dec << (unsigned)h.rd << std::hex << "=0x" << std::setw(8) << h.rd_val;
+        os << "\n";
+    }
+    if (core && ref_r) {
+        const HartRetire* side[2] = { core, ref_r };
+        const char*       name[2] = { "core     ", "reference" };
+        for (int s = 0; s < 2; s++) {
+            const HartRetire& h = *side[s];
+            os << name[s] << " pc 0x" << std::setw(8) << h.pc << "  instr " << std::setw(8) << h.instr;
+            if (h.rd)                    os << "  x" << std::dec << (unsigned)h.rd << std::hex << "=0x" << std::setw(8) << h.rd_val;
+            if (h.mem)                   os << "  addr 0x" << std::setw(8) << h.mem_addr;
+            if (h.mem & HART_MEM_STORE)  os << "  data 0x" << std::setw(8) << h.mem_val;
+            os << "\n";
+        }
+    }
+
+    os << "Registers (core / reference, * = differs):\n";
+    for (int i = 0; i < 32; i++) {
+        uint32_t c = (uint32_t)(uword_t)dut->regfile[i];
+        os << (c != ref.x[i] ? "*" : " ") << "x" << std::dec << std::setfill(' ') << std::setw(2) << i
+           << std::hex << std::setfill('0') << " " << std::setw(8) << c << "/" << std::setw(8) << ref.x[i]
+           << ((i % 4 == 3) ? "\n" : "   ");
+    }
+    os << "mstatus " << std::setw(8) << (uint32_t)(uword_t)dut->csr_mstatus << "/" << std::setw(8) << ref.mstatus
+       << "   mepc " << std::setw(8) << (uint32_t)(uword_t)dut->csr_mepc << "/" << std::setw(8) << ref.mepc
+       << "   mcause " << std::setw(8) << (uint32_t)(uword_t)dut->csr_mcause << "/" << std::setw(8) << ref.mcause
+       << "   mtvec " << std::setw(8) << (uint32_t)(uword_t)dut->csr_mtvec << "/" << std::setw(8) << ref.mtvec << "\n";
+    os << std::dec << std::setfill(' ');
+}
+
+#endif // REF_ISS_H
@@ -0,0 +1,321 @@
+#ifndef TIMING_MODEL_H
+#define TIMING_MODEL_H
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+#include "core.h"
+
+// =======================================================
+// Cycle-Approximate Timing Model (C-Sim Only)
+// =======================================================
+// The core counts one mcycle per instruction, so its "cycles" are really
+// instructions retired. TimingModel replays the retired stream
+// (hart_retire_hook) through a table of latencies and projects the cycle
+// count and CPI a real implementation would see. It does not feed back
+// into the core: mcycle, mtime and the timer interrupt keep their
+// one-per-instruction meaning.
+//
+// Each instruction costs 'base' cycles plus its extra latencies:
+//   fetch     every instruction (AXI read, or 0 for on-chip memory)
+//   memory    loads / stores / AMOs; MMIO (below DRAM_BASE) uses 'mmio'
+//   mul, div  M-extension multiply and divide/remainder
+//   branch    taken / not-taken conditional branches, JAL, JALR
+//   load-use  a load whose rd the next instruction reads
+//   trap      any other redirect: ECALL, EBREAK, MRET, exceptions and
+//             interrupt entry
+// Whether a branch was taken comes from the next retired pc, so each
+// instruction is charged when its successor retires (finish() flushes the
+// last one).
+//
+// The presets are estimates for the 200 MHz (5 ns) build in hls_config.cfg.
+// Calibrate them against cosim: run one benchmark in both and adjust until
+// the projected cycles match.
+
+struct TimingConfig {
+    const char* name;
+    double      clock_mhz;
+    unsigned    base;             // Cycles every instruction takes
+    unsigned    fetch;            // Extra per instruction fetch
+    unsigned    load;             // Extra per RAM load (twice if it crosses a word)
+    unsigned    store;            // Extra per RAM store (twice if it crosses a word)
+    unsigned    amo;              // Extra per AMO / LR / SC (RAM)
+    unsigned    mmio;             // Extra per MMIO access, instead of load/store
+    unsigned    mul;              // Extra per MUL/MULH/MULHSU/MULHU
+    unsigned    div;              // Extra per DIV/DIVU/REM/REMU
+    unsigned    branch_taken;     // Extra per taken conditional branch
+    unsigned    branch_not_taken; // Extra per not-taken conditional branch
+    unsigned    jal;              // Extra per JAL
+    unsigned    jalr;             // Extra per JALR
+    unsigned    load_use;         // Extra when the next instruction reads a load's rd
+    unsigned    trap;             // Extra per trap entry / MRET
+};
+
+// This core with ENABLE_ICACHE / ENABLE_DCACHE off: one instruction at a
+// time, every fetch a single-beat m_axi read from DDR, and memory() on the
+// bus directly (a load reads its word, a store reads the word, then writes
+// it; an access that crosses into the next word repeats that there). The
+// default build has both caches; run it through CACHE_SWEEP in
+// Testbench_elf_batch.cpp for the cached traffic.
+TimingConfig timing_multicycle();
+
+// Classic 5-stage in-order pipeline with full forwarding, branches resolved
+// in EX, and single-cycle on-chip instruction / data memories.
+TimingConfig timing_pipeline5();
+
+enum TimingClass {
+    TM_ALU, TM_LOAD, TM_STORE, TM_AMO, TM_MUL, TM_DIV,
+    TM_BRANCH, TM_JAL, TM_JALR, TM_CSR, TM_SYSTEM,
+    TM_CLASSES
+};
+
+enum TimingCause {
+    TC_BASE, TC_FETCH, TC_MEMORY, TC_MULDIV, TC_BRANCH, TC_LOAD_USE, TC_TRAP,
+    TC_CAUSES
+};
+
+class TimingModel {
+public:
+    explicit TimingModel(const TimingConfig& cfg = timing_pipeline5());
+
+    // Models every instruction 'h' retires from now on
+    void     attach(Hart& h);
+    // Detaches from 'h' and charges the last instruction
+    void     finish(Hart& h);
+
+    // Feeds one retired instruction (for callers with their own hook)
+    void     retire(const HartRetire& r);
+    // Charges the pending instruction without a successor
+    void     flush();
+    void     reset();
+
+    const TimingConfig& config() const { return cfg; }
+    uint64_t instructions() const      { return insns; }
+    uint64_t cycles() const;
+    double   cpi() const               { return insns ? (double)cycles() / (double)insns : 0.0; }
+    uint64_t cause_cycles(TimingCause c) const { return by_cause[c]; }
+    uint64_t class_count(TimingClass c) const  { return by_class[c]; }
+
+    // Projected cycles, CPI and runtime, split by cause and instruction class
+    void     print(std::ostream& os) const;
+
+    static TimingClass classify(uint32_t instr);
+    static bool        crosses(const HartRetire& r);
+    // True if 'instr' reads integer register 'reg' (reg != 0)
+    static bool        reads(uint32_t instr, unsigned reg);
+
+private:
+    TimingConfig cfg;
+    HartRetire   prev;
+    bool         pending;
+    uint64_t     insns;
+    uint64_t     taken;
+    uint64_t     by_cause[TC_CAUSES];
+    uint64_t     by_class[TM_CLASSES];
+
+    static void on_retire(void* ctx, const HartRetire& r);
+    void        charge(const HartRetire& r, const HartRetire* next);
+};
+
+// --- Implementations ---
+
+inline TimingConfig timing_multicycle() {
+    TimingConfig c;
+    c.name             = "multi-cycle, no caches";
+    c.clock_mhz        = 200.0;
+    c.base             = 4;  // Decode, execute, writeback, next pc
+    c.fetch            = 30; // DDR read through SmartConnect + MIG
+    c.load             = 30; // One word (word1 only when the load crosses into it)
+    c.store            = 50; // Read, then write with B response
+    c.amo              = 50; // Read, then write
+    c.mmio             = 12; // AXI-Lite peripheral
+    c.mul              = 3;  // DSP cascade
+    c.div              = 34; // Iterative divider
+    c.branch_taken     = 0;  // No pipeline to refill
+    c.branch_not_taken = 0;
+    c.jal              = 0;
+    c.jalr             = 0;
+    c.load_use         = 0;
+    c.trap             = 1;
+    return c;
+}
+
+inline TimingConfig timing_pipeline5() {
+    TimingConfig c;
+    c.name             = "5-stage pipeline, on-chip memory";
+    c.clock_mhz        = 200.0;
+    c.base             = 1;
+    c.fetch            = 0;
+    c.load             = 0;
+    c.store            = 0;
+    c.amo              = 1;  // Read-modify-write holds MEM for a cycle
+    c.mmio             = 12;
+    c.mul              = 1;
+    c.div              = 33;
+    c.branch_taken     = 2;  // Resolved in EX, no prediction
+    c.branch_not_taken = 0;
+    c.jal              = 1;  // Target known in ID
+    c.jalr             = 2;
+    c.load_use         = 1;
+    c.trap             = 3;
+    return c;
+}
+
+inline TimingModel::TimingModel(const TimingConfig& c) : cfg(c) {
+    reset();
+}
+
+inline void TimingModel::reset() {
+    memset(&prev, 0, sizeof(prev));
+    memset(by_cause, 0, sizeof(by_cause));
+    memset(by_class, 0, sizeof(by_class));
+    pending = false;
+    insns   = 0;
+    taken   = 0;
+}
+
+inline void TimingModel::attach(Hart& h) {
+    hart_retire_hook(h, on_retire, this);
+}
+
+inline void TimingModel::finish(Hart& h) {
+    hart_retire_hook(h, 0, 0);
+    flush();
+}
+
+inline void TimingModel::on_retire(void* ctx, const HartRetire& r) {
+    ((TimingModel*)ctx)->retire(r);
+}
+
+inline void TimingModel::retire(const HartRetire& r) {
+    if (pending) charge(prev, &r);
+    prev    = r;
+    pending = true;
+}
+
+inline void TimingModel::flush() {
+    if (pending) charge(prev, 0);
+    pending = false;
+}
+
+inline uint64_t TimingModel::cycles() const {
+    uint64_t n = 0;
+    for (unsigned i = 0; i < TC_CAUSES; i++) n += by_cause[i];
+    return n;
+}
+
+inline TimingClass TimingModel::classify(uint32_t instr) {
+    unsigned funct3 = (instr >> 12) & 7;
+    switch (instr & 0x7F) {
+        case 0x03: return TM_LOAD;
+        case 0x23: return TM_STORE;
+        case 0x2F: return TM_AMO;
+        case 0x63: return TM_BRANCH;
+        case 0x6F: return TM_JAL;
+        case 0x67: return TM_JALR;
+        case 0x33:
+            if ((instr >> 25) == 1) return funct3 < 4 ? TM_MUL : TM_DIV;
+            return TM_ALU;
+        case 0x73: return funct3 ? TM_CSR : TM_SYSTEM;
+        case 0x0F: return TM_SYSTEM; // FENCE / FENCE.I
+        default:   return TM_ALU;    // OP-IMM, LUI, AUIPC (illegal: trap)
+    }
+}
+
+inline bool TimingModel::reads(uint32_t instr, unsigned reg) {
+    if (reg == 0) return false;
+    unsigned rs1 = (instr >> 15) & 31;
+    unsigned rs2 = (instr >> 20) & 31;
+    switch (instr & 0x7F) {
+        case 0x33: case 0x23: case 0x63: case 0x2F:  // R-type, store, branch, AMO
+            return rs1 == reg || rs2 == reg;
+        case 0x13: case 0x03: case 0x67:             // OP-IMM, load, JALR
+            return rs1 == reg;
+        case 0x73:                                   // CSRRW/S/C (not the immediate forms)
+            return ((instr >> 12) & 7) != 0 && ((instr >> 12) & 4) == 0 && rs1 == reg;
+        default:
+            return false;
+    }
+}
+
+// A load / store that continues into the next word (funct3[1:0] = log2 size)
+inline bool TimingModel::crosses(const HartRetire& r) {
+    return (r.mem_addr & 3) + (1u << ((r.instr >> 12) & 0x3)) > 4;
+}
+
+inline void TimingModel::charge(const HartRetire& r, const HartRetire* next) {
+    TimingClass cls = classify(r.instr);
+    insns++;
+    by_class[cls]++;
+    by_cause[TC_BASE]  += cfg.base;
+    by_cause[TC_FETCH] += cfg.fetch;
+
+    if (r.mem) {
+        if (r.mem_addr < DRAM_BASE)                          by_cause[TC_MEMORY] += cfg.mmio;
+        else if (r.mem == (HART_MEM_LOAD | HART_MEM_STORE))  by_cause[TC_MEMORY] += cfg.amo;
+        else if (r.mem == HART_MEM_LOAD)                     by_cause[TC_MEMORY] += cfg.load * (crosses(r) ? 2 : 1);
+        else                                                 by_cause[TC_MEMORY] += cfg.store * (crosses(r) ? 2 : 1);
+    } else if (cls == TM_AMO) {
+        by_cause[TC_MEMORY] += cfg.amo; // SC that failed still holds MEM
+    }
+    if (cls == TM_MUL) by_cause[TC_MULDIV] += cfg.mul;
+    if (cls == TM_DIV) by_cause[TC_MULDIV] += cfg.div;
+    if (!next) return;
+
+    bool redirect = next->pc != r.pc + 4;
+    switch (cls) {
+        case TM_BRANCH:
+            if (redirect) taken++;
+            by_cause[TC_BRANCH] += redirect ? cfg.branch_taken : cfg.branch_not_taken;
+            break;
+        case TM_JAL:  by_cause[TC_BRANCH] += cfg.jal;  break;
+        case TM_JALR: by_cause[TC_BRANCH] += cfg.jalr; break;
+        default:
+            if (redirect) by_cause[TC_TRAP] += cfg.trap;
+            break;
+    }
+    if ((r.mem & HART_MEM_LOAD) && r.rd && reads(next->instr, r.rd)) by_cause[TC_LOAD_USE] += cfg.load_use;
+}
+
+inline void TimingModel::print(std::ostream& os) const {
+    static const char* cause_names[TC_CAUSES] = {
+        "base", "fetch", "memory", "mul/div", "branch", "load-use", "trap"
+    };
+    static const char* class_names[TM_CLASSES] = {
+        "alu", "load", "store", "amo", "mul", "div", "branch", "jal", "jalr", "csr", "system"
+    };
+    uint64_t total = cycles();
+
+    os << "\n==================================================================\n";
+    os << "  TIMING MODEL: " << cfg.name << "\n";
+    os << "==================================================================\n";
+    os << std::dec << "  instructions " << std::setw(14) << insns << "\n";
+    os << "  cycles       " << std::setw(14) << total << "  (CPI " << std::fixed << std::setprecision(2)
+       << cpi() << ", " << std::setprecision(3) << (cfg.clock_mhz > 0 ? (double)total / cfg.clock_mhz / 1000.0 : 0.0)
+       << " ms at " << std::setprecision(0) << cfg.clock_mhz << " MHz)\n";
+
+    os << "\n  cycles by cause\n";
+    for (unsigned i = 0; i < TC_CAUSES; i++) {
+        if (!by_cause[i]) continue;
+        double pct = total ? 100.0 * (double)by_cause[i] / (double)total : 0.0;
+        os << "    " << std::left << std::setw(10) << cause_names[i] << std::right << std::setw(14)
+           << by_cause[i] << std::setprecision(1) << std::setw(7) << pct << "%\n";
+    }
+
+    os << "\n  instruction mix\n";
+    for (unsigned i = 0; i < TM_CLASSES; i++) {
+        if (!by_class[i]) continue;
+        double pct = insns ? 100.0 * (double)by_class[i] / (double)insns : 0.0;
+        os << "    " << std::left << std::setw(10) << class_names[i] << std::right << std::setw(14)
+           << by_class[i] << std::setprecision(1) << std::setw(7) << pct << "%";
+        if (i == TM_BRANCH && by_class[i]) {
+            os << "  (" << 100.0 * (double)taken / (double)by_class[i] << "% taken)";
+        }
+        os << "\n";
+    }
+    os.unsetf(std::ios::floatfield);
+    os << std::setprecision(6);
+}
+
+#endif // TIMING_MODEL_H
@@ -3,11 +3,18 @@
 #include <cstring>
 #include "core.h" 
 #include <cstdio>
+#ifndef __SYNTHESIS__
+#include "jit_x86.h"
+#endif
 
 // ------------------------------------------------------------
 // Global Debug Switch
 // ------------------------------------------------------------
 bool CORE_DEBUG = true; // This must be toggled in the testbench
+#ifndef __SYNTHESIS__
+bool CORE_BLOCK_ENGINE = false; // C-Sim only: run cached basic blocks (toggled in the testbench)
+bool CORE_JIT = false;          // C-Sim only: translate hot blocks to x86-64 (needs CORE_BLOCK_ENGINE)
+#endif
 
 // ------------------------------------------------------------  
 // Global Configuration Switch
@@ -15,49 +22,88 @@ bool CORE_DEBUG = true; // This must be toggled in the testbench
 // If false, the M-extension logic is completely pruned during synthesis.
 const bool ENABLE_M_EXTENSION = true;
 const bool ENABLE_A_EXTENSION = true; // Toggle for Atomics
+const bool ENABLE_ICACHE = true;          // BRAM instruction cache (geometry in core.h)
+const bool ENABLE_DCACHE = true;          // BRAM write-back data cache (geometry in core.h)
+const bool ENABLE_PREDECODE_CACHE = true; // C-Sim only: reuse decoded instructions
+
+// ------------------------------------------------------------
+// Word Helpers
+// ------------------------------------------------------------
+// Written once for both word flavours (see core.h). Signed adds go through
+// the unsigned type so the native build never relies on signed overflow.
+template<int HI, int LO> static inline uword_t bits(uword_t x) {
+    #pragma HLS INLINE
+    return (x >> LO) & (uword_t)((1ULL << (HI - LO + 1)) - 1);
+}
+
+template<int N> static inline bool bit(uword_t x) {
+    #pragma HLS INLINE
+    return (x >> N) & 1;
+}
+
+// Sign-extend the low N bits of x
+template<int N> static inline sword_t sext(uword_t x) {
+    #pragma HLS INLINE
+    #ifdef CORE_NATIVE_WORDS
+        return (sword_t)(x << (32 - N)) >> (32 - N);
+    #else
+        return (sword_t)((ap_int<N>)x);
+    #endif
+}
+
+static inline sword_t wrap_add(sword_t a, sword_t b) {
+    #pragma HLS INLINE
+    return (sword_t)(uword_t)((uword_t)a + (uword_t)b);
+}
+
+static inline sword_t wrap_sub(sword_t a, sword_t b) {
+    #pragma HLS INLINE
+    return (sword_t)(uword_t)((uword_t)a - (uword_t)b);
+}
 
 // ------------------------------------------------------------
 // Inter-Stage Data Structs
 // ------------------------------------------------------------
 struct FetchOut {
-    ap_uint<32> instr;
-    ap_uint<32> pc;
+    uword_t instr;
+    uword_t pc;
 };
 
 struct DecodeOut {
-    ap_uint<7>  opcode;
-    ap_uint<5>  rd;
-    ap_uint<3>  funct3;
-    ap_uint<5>  rs1;
-    ap_uint<5>  rs2;
-    ap_uint<7>  funct7;
-    ap_int<32>  imm;
-    ap_int<32>  pc;
-    ap_int<32>  rs1_val;
-    ap_int<32>  rs2_val;
-    ap_uint<32> instr;
+    opcode_t    opcode;
+    regidx_t    rd;
+    funct3_t    funct3;
+    regidx_t    rs1;
+    regidx_t    rs2;
+    funct7_t    funct7;
+    sword_t  imm;
+    sword_t  pc;
+    sword_t  rs1_val;
+    sword_t  rs2_val;
+    uword_t instr;
 };
 
 struct ExecOut {
-    ap_int<32>  alu_result;
-    ap_uint<5>  rd;
+    sword_t  alu_result;
+    regidx_t    rd;
     bool        mem_read;
     bool        mem_write;
     bool        reg_write;
-    ap_uint<3>  funct3;
-    ap_int<32>  store_val;
+    funct3_t    funct3;
+    sword_t  store_val;
     bool        is_trap;
     bool        is_atomic;
-    ap_uint<5>  atomic_op;
+    amoop_t     atomic_op;
     // Control signals
     bool        branch_taken;
-    ap_uint<32> next_pc;
+    uword_t next_pc;
     bool        finished;
+    bool        fence_i;     // Memory stage: write back the D-cache, drop the I-cache
 };
 
 struct MemOut {
-    ap_int<32>  value;
-    ap_uint<5>  rd;
+    sword_t  value;
+    regidx_t    rd;
     bool        reg_write;
     bool        is_trap;
 };
@@ -78,132 +124,701 @@ static unsigned addr_to_idx(unsigned byte_addr) {
 }
 
 // ------------------------------------------------------------
-// Global Architectural State
+// Instruction Cache
 // ------------------------------------------------------------
-#ifdef __SYNTHESIS__
-    ap_uint<32> pc = 0x80000000; 
-#else
-    ap_uint<32> pc = 0;          
+// Set-associative (ICACHE_WAYS = 1: direct mapped) on RAM word indices.
+// A miss reads the whole line in one AXI burst into the round-robin
+// victim way. Like any RISC-V I-cache it does not snoop stores: code
+// written by the core runs after a FENCE.I, which drops every line.
+// In C-sim the predecode and block caches sit in front of it. Both fill
+// through this cache, so they hold exactly the words fetch() returns. A
+// store into code only makes them refetch, and the refetch gets the stale
+// I-cache copy, or stale DRAM while the store sits in a dirty D-cache line.
+// Code written without a FENCE.I therefore runs stale in C-sim, as it would
+// in hardware.
+static_assert((ICACHE_WAYS & (ICACHE_WAYS - 1)) == 0 && ICACHE_WAYS <= 256, "ICACHE_WAYS: power of two, <= 256");
+static_assert((ICACHE_SETS & (ICACHE_SETS - 1)) == 0, "ICACHE_SETS: power of two");
+static_assert((ICACHE_LINE_WORDS & (ICACHE_LINE_WORDS - 1)) == 0, "ICACHE_LINE_WORDS: power of two");
+
+static void icache_invalidate(Hart& h) {
+    #pragma HLS INLINE
+    ICACHE_CLEAR: for (int s = 0; s < ICACHE_SETS; s++) {
+        #pragma HLS UNROLL
+        for (int w = 0; w < ICACHE_WAYS; w++) h.icache_valid[w][s] = false;
+    }
+}
+
+static uword_t icache_read(Hart& h, volatile uint32_t* ram, unsigned idx) {
+    #pragma HLS INLINE
+    unsigned line = idx / ICACHE_LINE_WORDS;
+    unsigned set  = line % ICACHE_SETS;
+    unsigned tag  = line / ICACHE_SETS;
+    unsigned base = set * ICACHE_LINE_WORDS;
+
+    bool     hit = false;
+    unsigned way = 0;
+    ICACHE_LOOKUP: for (int w = 0; w < ICACHE_WAYS; w++) {
+        #pragma HLS UNROLL
+        if (h.icache_valid[w][set] && h.icache_tag[w][set] == tag) {
+            hit = true;
+            way = w;
+        }
+    }
+
+    if (!hit) {
+        way = h.icache_victim[set];
+        h.icache_victim[set] = (uint8_t)((way + 1) % ICACHE_WAYS);
+        // Instruction memory has no read side effects: a non-volatile view
+        // of the line lets HLS turn the loop into one burst
+        const uint32_t* src = (const uint32_t*)ram + line * ICACHE_LINE_WORDS;
+        ICACHE_REFILL: for (int i = 0; i < ICACHE_LINE_WORDS; i++) {
+            #pragma HLS PIPELINE II=1
+            h.icache_data[way][base + i] = (uword_t)src[i];
+        }
+        h.icache_tag[way][set]   = tag;
+        h.icache_valid[way][set] = true;
+    }
+    return h.icache_data[way][base + idx % ICACHE_LINE_WORDS];
+}
+
+// ------------------------------------------------------------
+// Data Cache
+// ------------------------------------------------------------
+// Write-back, write-allocate, set-associative on RAM word indices. A miss
+// writes the victim line back if it is dirty, then reads the new one, each
+// as one AXI burst. After that, loads and stores (including the two words
+// of a misaligned access) are BRAM accesses. Only DRAM is cached, so UART
+// and CLINT accesses still reach the bus one by one. RAM is current once
+// dcache_flush runs: on FENCE.I (before the I-cache is dropped, so
+// code written by stores is what gets fetched) and when the hart returns.
+static_assert((DCACHE_WAYS & (DCACHE_WAYS - 1)) == 0 && DCACHE_WAYS <= 256, "DCACHE_WAYS: power of two, <= 256");
+static_assert((DCACHE_SETS & (DCACHE_SETS - 1)) == 0, "DCACHE_SETS: power of two");
+static_assert((DCACHE_LINE_WORDS & (DCACHE_LINE_WORDS - 1)) == 0, "DCACHE_LINE_WORDS: power of two");
+
+// Drops every line without writing back (reset: RAM was reloaded)
+static void dcache_invalidate(Hart& h) {
+    #pragma HLS INLINE
+    DCACHE_CLEAR: for (int s = 0; s < DCACHE_SETS; s++) {
+        #pragma HLS UNROLL
+        for (int w = 0; w < DCACHE_WAYS; w++) {
+            h.dcache_valid[w][s] = false;
+            h.dcache_dirty[w][s] = false;
+        }
+    }
+}
+
+static void dcache_writeback(Hart& h, volatile uint32_t* ram, unsigned way, unsigned set) {
+    #pragma HLS INLINE
+    unsigned line = (unsigned)h.dcache_tag[way][set] * DCACHE_SETS + set;
+    unsigned base = set * DCACHE_LINE_WORDS;
+    // DRAM lines only: a non-volatile view lets HLS burst the loop
+    uint32_t* dst = (uint32_t*)ram + line * DCACHE_LINE_WORDS;
+    DCACHE_EVICT: for (int i = 0; i < DCACHE_LINE_WORDS; i++) {
+        #pragma HLS PIPELINE II=1
+        dst[i] = (uint32_t)h.dcache_data[way][base + i];
+    }
+    h.dcache_dirty[way][set] = false;
+}
+
+// Way holding word 'idx', filled (after evicting the victim) on a miss
+static unsigned dcache_line(Hart& h, volatile uint32_t* ram, unsigned idx) {
+    #pragma HLS INLINE
+    unsigned line = idx / DCACHE_LINE_WORDS;
+    unsigned set  = line % DCACHE_SETS;
+    unsigned tag  = line / DCACHE_SETS;
+
+    bool     hit = false;
+    unsigned way = 0;
+    DCACHE_LOOKUP: for (int w = 0; w < DCACHE_WAYS; w++) {
+        #pragma HLS UNROLL
+        if (h.dcache_valid[w][set] && h.dcache_tag[w][set] == tag) {
+            hit = true;
+            way = w;
+        }
+    }
+    if (hit) return way;
+
+    way = h.dcache_victim[set];
+    h.dcache_victim[set] = (uint8_t)((way + 1) % DCACHE_WAYS);
+    if (h.dcache_valid[way][set] && h.dcache_dirty[way][set]) dcache_writeback(h, ram, way, set);
+
+    unsigned base = set * DCACHE_LINE_WORDS;
+    const uint32_t* src = (const uint32_t*)ram + line * DCACHE_LINE_WORDS;
+    DCACHE_REFILL: for (int i = 0; i < DCACHE_LINE_WORDS; i++) {
+        #pragma HLS PIPELINE II=1
+        h.dcache_data[way][base + i] = (uword_t)src[i];
+    }
+    h.dcache_tag[way][set]   = tag;
+    h.dcache_valid[way][set] = true;
+    h.dcache_dirty[way][set] = false;
+    return way;
+}
+
+// Writes every dirty line back to RAM; lines stay cached (clean)
+static void dcache_flush(Hart& h, volatile uint32_t* ram) {
+    #pragma HLS INLINE
+    if (!ENABLE_DCACHE) return;
+    DCACHE_FLUSH: for (int s = 0; s < DCACHE_SETS; s++) {
+        for (int w = 0; w < DCACHE_WAYS; w++) {
+            if (h.dcache_valid[w][s] && h.dcache_dirty[w][s]) dcache_writeback(h, ram, w, s);
+        }
+    }
+}
+
+// Word 'idx' of DRAM, through the cache when 'cached'
+static uword_t dmem_read(Hart& h, volatile uint32_t* ram, unsigned idx, bool cached) {
+    #pragma HLS INLINE
+    if (!cached) return (uword_t)ram[idx];
+    unsigned way = dcache_line(h, ram, idx);
+    return h.dcache_data[way][(idx / DCACHE_LINE_WORDS % DCACHE_SETS) * DCACHE_LINE_WORDS + idx % DCACHE_LINE_WORDS];
+}
+
+// Replaces the 'mask' bits of word 'idx' with those of 'val'. Uncached
+// words are read, merged and written back.
+static void dmem_write(Hart& h, volatile uint32_t* ram, unsigned idx, uword_t val, uword_t mask, bool cached) {
+    #pragma HLS INLINE
+    if (!cached) {
+        uword_t word = (uword_t)ram[idx];
+        ram[idx] = (uint32_t)((word & ~mask) | (val & mask));
+        return;
+    }
+    unsigned way = dcache_line(h, ram, idx);
+    unsigned set = idx / DCACHE_LINE_WORDS % DCACHE_SETS;
+    uword_t& word = h.dcache_data[way][set * DCACHE_LINE_WORDS + idx % DCACHE_LINE_WORDS];
+    word = (word & ~mask) | (val & mask);
+    h.dcache_dirty[way][set] = true;
+}
+
+// ------------------------------------------------------------
+// Predecode Cache (C-Sim Only)
+// ------------------------------------------------------------
+// Direct-mapped on the RAM word index. Holds the PC-independent part of
+// decode() so hot loops skip the field extraction and sext* rebuilds.
+// Any write to a cached word drops that line; FENCE.I drops everything.
+#ifndef __SYNTHESIS__
+#define PREDECODE_ENTRIES 65536
+
+struct PredecodeEntry {
+    unsigned  gen;   // Valid when equal to predecode_gen
+    unsigned  idx;   // RAM word index (tag)
+    DecodeOut d;     // pc / rs1_val / rs2_val are filled per use
+};
+
+// ------------------------------------------------------------
+// Basic-Block Cache (C-Sim Only)
+// ------------------------------------------------------------
+// A block is a run of decoded instructions starting at some PC and ending
+// at the first control-flow / SYSTEM / FENCE instruction. Instructions live
+// in a bump-allocated arena; a word bitmap marks RAM covered by any block
+// so a store into code flushes the whole cache (self-modifying code).
+// Blocks are decoded from what fetch() would return (the I-cache), not
+// from RAM.
+#define BLOCK_ENTRIES    16384
+#define BLOCK_MAX_INSNS  64
+#define BLOCK_ARENA_SIZE 262144
+#define JIT_THRESHOLD    32     // Block executions before translation
+#define WFI_INSTR        0x10500073
+
+struct BasicBlock {
+    unsigned    gen;         // Valid when equal to block_gen
+    unsigned    start_idx;   // RAM word index of the first instruction (tag)
+    unsigned    first;       // Offset into block_arena
+    unsigned    count;       // Number of instructions
+    // Chaining: successor blocks, validated on use
+    BasicBlock* next_fall;
+    BasicBlock* next_taken;
+    uword_t taken_pc;
+    // Translation (CORE_JIT)
+    unsigned    hits;
+    bool        jit_tried;
+    JitFn       jit;
+    uword_t jit_pc;      // Translated code has its PC baked in
+};
+
+// ------------------------------------------------------------
+// UART Device Model (C-Sim Only)
+// ------------------------------------------------------------
+// Minimal 16550 at 0x10000000 (reg-shift 0). THR writes go into a TX FIFO
+// that shifts out one byte per UART_TX_CYCLES (0 = immediately); LSR
+// reports THRE / TEMT once the FIFO has emptied. Shifted-out bytes collect
+// in a host buffer that is written in bulk on newline, when full, and before
+// the core prints anything itself, so console output keeps its order.
+#define UART_FIFO_DEPTH  16
+#define UART_TX_CYCLES   0
+#define UART_HOST_BUFFER 4096
+
+struct UartSim {
+    uint8_t  regs[8];          // Last value written per register (IER, FCR, LCR, MCR, SCR)
+    uint8_t  dll, dlm;         // Divisor latch (LCR.DLAB = 1)
+    uint8_t  fifo[UART_FIFO_DEPTH];
+    unsigned fifo_head;
+    unsigned fifo_count;
+    uint64_t tx_done;          // mcycle at which the head byte has been sent
+    char     out[UART_HOST_BUFFER];
+    unsigned out_len;
+};
+
+// ------------------------------------------------------------
+// Execution Profile (C-Sim Only)
+// ------------------------------------------------------------
+// Exact per-PC counts of retired instructions and cycles (hart_profile).
+// Counters are allocated per RAM page on first execution, so profiling a
+// small program costs a few pages, not a counter for every RAM word.
+struct ProfilePage {
+    uint64_t insns[1 << RAM_PAGE_SHIFT];
+    uint64_t cycles[1 << RAM_PAGE_SHIFT];
+};
+
+// ------------------------------------------------------------
+// Per-Hart Simulation State (C-Sim Only)
+// ------------------------------------------------------------
+// Everything above is derived from one hart's view of its RAM, so each
+// hart owns its own copy; harts on different threads share nothing.
+struct HartSim {
+    // Predecode cache
+    PredecodeEntry predecode_cache[PREDECODE_ENTRIES];
+    unsigned       predecode_gen;
+
+    // Block cache
+    BasicBlock block_table[BLOCK_ENTRIES];
+    DecodeOut  block_arena[BLOCK_ARENA_SIZE];
+    bool       block_observes[BLOCK_ARENA_SIZE]; // Reads mcycle/minstret (loads, stores, AMOs, last in block)
+    unsigned   block_arena_used;
+    unsigned   block_gen;
+
+    uint32_t   block_code_map[RAM_SIZE / 32];
+    unsigned   block_code_lo;
+    unsigned   block_code_hi;
+
+    // JIT (created on first use)
+    JitCache*  jit_cache;
+    bool       jit_failed;
+    volatile uint32_t* jit_ram; // RAM of the current riscv_step call (helper context)
+
+    // Write tracking (hart_track_writes): one byte per RAM page
+    uint8_t*   dirty_pages;
+
+    // Cycles skipped by the WFI fast-forward (hart_idle_cycles)
+    uint64_t   idle_cycles;
+
+    // Console
+    UartSim    uart;
+
+    // Profiler (hart_profile): one entry per RAM page, 0 = off
+    ProfilePage** prof;
+
+    // Call/return events (hart_call_hook), 0 = off
+    HartCallHook  call_hook;
+    void*         call_ctx;
+
+    // Retired instructions (hart_retire_hook), 0 = off
+    HartRetireHook retire_hook;
+    void*          retire_ctx;
+
+    // hart_stop request, checked between instructions
+    bool           stop;
+};
+
+static HartSim* hart_sim_create() {
+    HartSim* s = new HartSim(); // Value-initialized: all tags invalid
+    s->predecode_gen    = 1;
+    s->block_arena_used = 0;
+    s->block_gen        = 1;
+    s->block_code_lo    = RAM_SIZE;
+    s->block_code_hi    = 0;
+    s->jit_cache        = 0;
+    s->jit_failed       = false;
+    s->jit_ram          = 0;
+    s->dirty_pages      = 0;
+    s->idle_cycles      = 0;
+    s->prof             = 0;
+    s->call_hook        = 0;
+    s->call_ctx         = 0;
+    s->retire_hook      = 0;
+    s->retire_ctx       = 0;
+    s->stop             = false;
+    return s;
+}
+
+static void predecode_flush(HartSim& s) {
+    s.predecode_gen++;
+    if (s.predecode_gen == 0) { // Wrapped: old tags could look valid again
+        for (int i = 0; i < PREDECODE_ENTRIES; i++) s.predecode_cache[i].gen = 0;
+        s.predecode_gen = 1;
+    }
+}
+
+static void predecode_invalidate(HartSim& s, unsigned idx) {
+    PredecodeEntry& p = s.predecode_cache[idx & (PREDECODE_ENTRIES - 1)];
+    if (p.gen == s.predecode_gen && p.idx == idx) p.gen = 0;
+}
+
+static void block_flush(HartSim& s) {
+    s.block_gen++;
+    if (s.block_gen == 0) {
+        for (int i = 0; i < BLOCK_ENTRIES; i++) s.block_table[i].gen = 0;
+        s.block_gen = 1;
+    }
+    s.block_arena_used = 0;
+    jit_reset(s.jit_cache);
+    if (s.block_code_lo <= s.block_code_hi) {
+        for (unsigned w = s.block_code_lo >> 5; w <= (s.block_code_hi >> 5); w++) s.block_code_map[w] = 0;
+    }
+    s.block_code_lo = RAM_SIZE;
+    s.block_code_hi = 0;
+}
+
+// Called for every RAM word written by the core
+static void code_write(HartSim& s, unsigned idx) {
+    if (s.dirty_pages) s.dirty_pages[idx >> RAM_PAGE_SHIFT] = 1;
+    predecode_invalidate(s, idx);
+    if ((s.block_code_map[idx >> 5] >> (idx & 31)) & 1) block_flush(s);
+}
+
+// Called on FENCE.I and reset
+static void code_flush(HartSim& s) {
+    predecode_flush(s);
+    block_flush(s);
+}
+
+// --- UART ---
+static void uart_flush(HartSim& s) {
+    UartSim& u = s.uart;
+    if (u.out_len == 0) return;
+    std::cout.write(u.out, u.out_len);
+    std::cout.flush();
+    u.out_len = 0;
+}
+
+// Moves every byte that has finished transmitting by 'now' to the host
+static void uart_drain(HartSim& s, uint64_t now) {
+    UartSim& u = s.uart;
+    while (u.fifo_count > 0 && now >= u.tx_done) {
+        char c = (char)u.fifo[u.fifo_head];
+        u.fifo_head = (u.fifo_head + 1) % UART_FIFO_DEPTH;
+        u.fifo_count--;
+        u.tx_done += UART_TX_CYCLES;
+
+        u.out[u.out_len++] = c;
+        if (c == '\n' || u.out_len == UART_HOST_BUFFER || CORE_LOG) uart_flush(s);
+    }
+}
+
+static void uart_write(HartSim& s, unsigned reg, uint8_t val, uint64_t now) {
+    UartSim& u = s.uart;
+    bool dlab = (u.regs[3] >> 7) & 1;
+    if (reg == 0 && dlab)      u.dll = val;
+    else if (reg == 1 && dlab) u.dlm = val;
+    else if (reg == 0) {       // THR
+        uart_drain(s, now);
+        if (u.fifo_count == UART_FIFO_DEPTH) return; // Overrun: byte lost
+        if (u.fifo_count == 0) u.tx_done = now + UART_TX_CYCLES;
+        u.fifo[(u.fifo_head + u.fifo_count) % UART_FIFO_DEPTH] = val;
+        u.fifo_count++;
+        uart_drain(s, now);
+    }
+    else u.regs[reg] = val;
+}
+
+static uint8_t uart_read(HartSim& s, unsigned reg, uint64_t now) {
+    UartSim& u = s.uart;
+    bool dlab = (u.regs[3] >> 7) & 1;
+    switch (reg) {
+        case 0:  return dlab ? u.dll : 0;                    // RBR: no receive path
+        case 1:  return dlab ? u.dlm : u.regs[1];            // IER
+        case 2:  return (u.regs[2] & 1) ? 0xC1 : 0x01;       // IIR: nothing pending
+        case 5: {                                            // LSR
+            uart_drain(s, now);
+            uint8_t lsr = 0;
+            // With FIFOs on, THRE means the FIFO is empty, not that it has
+            // room: the 8250 driver writes up to 16 bytes each time it is set
+            if (u.fifo_count == 0) lsr |= 0x20 | 0x40;       // THRE, TEMT: all sent
+            return lsr;
+        }
+        case 6:  return 0;                                   // MSR
+        default: return u.regs[reg];                         // LCR, MCR, SCR
+    }
+}
+
+// Sends everything still queued (end of run)
+static void uart_finish(HartSim& s) {
+    uart_drain(s, ~0ULL);
+    uart_flush(s);
+}
+
+// --- Profiler ---
+static void prof_count(HartSim& s, unsigned pc, uint64_t insns, uint64_t cycles) {
+    unsigned idx = addr_to_idx(pc);
+    if (idx >= RAM_SIZE) return;
+    ProfilePage*& p = s.prof[idx >> RAM_PAGE_SHIFT];
+    if (!p) p = new ProfilePage();
+    p->insns[idx & ((1 << RAM_PAGE_SHIFT) - 1)]  += insns;
+    p->cycles[idx & ((1 << RAM_PAGE_SHIFT) - 1)] += cycles;
+}
+
+static void prof_clear(HartSim& s) {
+    if (!s.prof) return;
+    for (unsigned p = 0; p < (RAM_SIZE >> RAM_PAGE_SHIFT); p++) {
+        delete s.prof[p];
+        s.prof[p] = 0;
+    }
+}
+
+// --- Call Tracing ---
+static void call_event(Hart& h, HartCallKind kind, unsigned pc, unsigned target) {
+    HartSim& s = *h.sim;
+    if (s.call_hook) s.call_hook(s.call_ctx, kind, pc, target, (uint64_t)h.csr_mcycle);
+}
+
+// Return-address stack hints of the ISA spec (JALR table), link = x1 or x5:
+// rd link -> call; rs1 link -> return; both link and different -> return,
+// then call (coroutine swap). JAL has no rs1 (pass 0).
+static void call_jump(Hart& h, unsigned rd, unsigned rs1, unsigned pc, unsigned target) {
+    if (!h.sim->call_hook) return;
+    bool rd_link  = (rd == 1 || rd == 5);
+    bool rs1_link = (rs1 == 1 || rs1 == 5);
+    if (rs1_link && !(rd_link && rd == rs1)) call_event(h, HART_RETURN, pc, target);
+    if (rd_link) call_event(h, HART_CALL, pc, target);
+}
+
+// --- Retire Tracing ---
+static void retire_event(HartSim& s, const DecodeOut& d, const ExecOut& e, const MemOut& m) {
+    HartRetire r;
+    r.pc       = (uint32_t)(uword_t)d.pc;
+    r.instr    = (uint32_t)d.instr;
+    r.rd       = (m.reg_write && m.rd != 0) ? (uint8_t)m.rd : 0;
+    r.rd_val   = r.rd ? (uint32_t)(uword_t)m.value : 0;
+    r.mem      = 0;
+    r.mem_addr = 0;
+    r.mem_val  = 0;
+    if (!e.is_trap && (e.mem_read || e.mem_write || e.is_atomic)) {
+        r.mem_addr = (uint32_t)(uword_t)e.alu_result;
+        if (e.mem_read || e.is_atomic)  r.mem |= HART_MEM_LOAD;
+        if (e.mem_write || e.is_atomic) r.mem |= HART_MEM_STORE;
+        if (r.mem & HART_MEM_STORE)     r.mem_val = (uint32_t)(uword_t)e.store_val;
+    }
+    s.retire_hook(s.retire_ctx, r);
+}
 #endif
-ap_int<32>  regfile[32];
-bool is_finished = false;
-
-// --- Load Reserved / Store Conditional State ---
-ap_uint<32> lr_addr = 0;
-bool lr_valid = false;
-
-// --- CSRs ---
-ap_uint<32> csr_mtvec = 0;
-ap_uint<32> csr_mepc = 0;
-ap_uint<32> csr_mcause = 0;
-ap_uint<32> csr_mscratch = 0;
-
-ap_uint<64> csr_mcycle = 0;   // Cycle Counter (0xB00/0xB80)
-ap_uint<64> csr_minstret = 0; // Instructions Retired (0xB02/0xB82)
-ap_uint<32> csr_mstatus = 0;  // Status Register (0x300)
-
-// --- Interrupts & Timer ---
-ap_uint<32> csr_mie = 0; // Interrupt Enable Register (0x304)
-ap_uint<32> csr_mip = 0; // Interrupt Pending Register (0x344)
-ap_uint<64> mtimecmp = 0xFFFFFFFFFFFFFFFF;
-
-// --- Sink CSRs (accept writes, minimal/no effect in M-mode-only core) ---
-ap_uint<32> csr_mtval = 0;         // Trap Value (0x343)
-ap_uint<32> csr_medeleg = 0;       // Exception Delegation (0x302) - no S-mode, sink
-ap_uint<32> csr_mideleg = 0;       // Interrupt Delegation (0x303) - no S-mode, sink
-ap_uint<32> csr_mcountinhibit = 0; // Counter Inhibit (0x320)
-ap_uint<32> csr_satp = 0;          // S-mode Address Translation (0x180) - sink
 
 // --- Global Variable Master Definitions ---
 ap_uint<32> ENTRY_PC;
 ap_uint<32> DTB_ADDR;
 
+// ------------------------------------------------------------
+// Interrupt Scheduling
+// ------------------------------------------------------------
+// The timer is the only interrupt source. Instead of re-deriving MTIP and
+// the enables every cycle, hart_step compares mcycle against irq_deadline:
+// the first cycle at which the timer interrupt can be taken, or never while
+// it is masked. Every write to mtimecmp / mstatus / mie / mip reschedules.
+static inline void irq_schedule(Hart& h) {
+    #pragma HLS INLINE
+    bool irq_en = ((h.csr_mstatus >> 3) & 1) && ((h.csr_mie >> 7) & 1);
+    h.irq_deadline = irq_en ? h.mtimecmp : (udword_t)0xFFFFFFFFFFFFFFFFULL;
+}
+
+// Trap entry (exception or interrupt): MPIE = MIE, MIE = 0
+static inline void mstatus_trap(Hart& h) {
+    #pragma HLS INLINE
+    bool old_mie = (h.csr_mstatus >> 3) & 1;
+    if (old_mie) h.csr_mstatus |= (1 << 7);
+    else         h.csr_mstatus &= ~(1 << 7);
+    h.csr_mstatus &= ~(1 << 3);
+    irq_schedule(h);
+}
+
+// MTIP follows mtime (= mcycle) >= mtimecmp and is derived when read
+static inline uword_t mip_read(const Hart& h) {
+    #pragma HLS INLINE
+    uword_t mtip = (h.csr_mcycle >= h.mtimecmp) ? (uword_t)(1 << 7) : (uword_t)0;
+    return (h.csr_mip & ~(uword_t)(1 << 7)) | mtip;
+}
+
 // ------------------------------------------------------------
 // Initialization Function
 // ------------------------------------------------------------
-void riscv_init() {
-    pc = ENTRY_PC;
-    for(int i=0; i<32; i++) regfile[i] = 0;
+void hart_init(Hart& h, uword_t entry_pc) {
+    h.pc = entry_pc;
+    for(int i=0; i<32; i++) h.regfile[i] = 0;
 
-    regfile[1] = (ap_int<32>)0xDEADBEEF;       
-    regfile[0] = 0;                           
-    regfile[2] = (ap_int<32>) (unsigned)DMEM_STACK_TOP;
+    h.regfile[1] = (sword_t)0xDEADBEEF;       
+    h.regfile[0] = 0;                           
+    h.regfile[2] = (sword_t) (unsigned)DMEM_STACK_TOP;
 
     //Linux setup
-    regfile[10] = 0;         // a0 = Hart ID (0)
-    regfile[11] = 0x80800000; // a1 = Device Tree Address
+    h.regfile[10] = 0;         // a0 = Hart ID (0)
+    h.regfile[11] = 0x80800000; // a1 = Device Tree Address
     
-    if(CORE_DEBUG) {
-        std::cout << "[INIT] Core Reset. PC=0x" << std::hex << (unsigned)pc 
-                  << ", SP=0x" << (unsigned)regfile[2] << std::dec << std::endl;
+    if(CORE_LOG) {
+        std::cout << "[INIT] Core Reset. PC=0x" << std::hex << (unsigned)h.pc 
+                  << ", SP=0x" << (unsigned)h.regfile[2] << std::dec << std::endl;
     }
 
-    is_finished = false;
+    h.is_finished = false;
+
+    h.csr_mcycle = 0;
+    h.csr_minstret = 0;
+    h.csr_mstatus = 0;
 
-    csr_mcycle = 0;
-    csr_minstret = 0;
-    csr_mstatus = 0;
+    // Reset Trap CSRs (a reused hart must not inherit the last program's handler)
+    h.csr_mtvec = 0;
+    h.csr_mepc = 0;
+    h.csr_mcause = 0;
+    h.csr_mscratch = 0;
     
     // Reset Timer state
-    csr_mie = 0;
-    csr_mip = 0;
-    mtimecmp = 0xFFFFFFFFFFFFFFFF;
+    h.csr_mie = 0;
+    h.csr_mip = 0;
+    h.mtimecmp = 0xFFFFFFFFFFFFFFFF;
+    irq_schedule(h);
 
     // Reset Sink CSRs
-    csr_mtval = 0;
-    csr_medeleg = 0;
-    csr_mideleg = 0;
-    csr_mcountinhibit = 0;
-    csr_satp = 0;
+    h.csr_mtval = 0;
+    h.csr_medeleg = 0;
+    h.csr_mideleg = 0;
+    h.csr_mcountinhibit = 0;
+    h.csr_satp = 0;
 
     // Reset Atomic State
-    lr_valid = false;
-    lr_addr = 0;
+    h.lr_valid = false;
+    h.lr_addr = 0;
+
+    icache_invalidate(h);
+    dcache_invalidate(h);
+
+    #ifndef __SYNTHESIS__
+    if (!h.sim) h.sim = hart_sim_create();
+    code_flush(*h.sim); // RAM may have been reloaded by the testbench
+    h.sim->idle_cycles = 0;
+    h.sim->stop = false;
+    prof_clear(*h.sim);
+    uart_finish(*h.sim);
+    memset(&h.sim->uart, 0, sizeof(UartSim));
+    #endif
+}
+
+#ifndef __SYNTHESIS__
+void hart_track_writes(Hart& h, uint8_t* page_map) {
+    if (!h.sim) h.sim = hart_sim_create();
+    h.sim->dirty_pages = page_map;
 }
 
+void hart_restore(Hart& h, const Hart& state) {
+    HartSim* sim = h.sim;
+    h = state;
+    h.sim = sim;
+    irq_schedule(h); // Derived state: not trusted from 'state'
+    icache_invalidate(h);
+    dcache_invalidate(h);
+    if (!h.sim) h.sim = hart_sim_create();
+    code_flush(*h.sim); // RAM was restored along with the state
+}
+
+uint64_t hart_idle_cycles(const Hart& h) {
+    return h.sim ? h.sim->idle_cycles : 0;
+}
+
+void hart_profile(Hart& h, bool enable) {
+    if (!h.sim) h.sim = hart_sim_create();
+    HartSim& s = *h.sim;
+    if (enable && !s.prof) {
+        s.prof = new ProfilePage*[RAM_SIZE >> RAM_PAGE_SHIFT]();
+    } else if (!enable && s.prof) {
+        prof_clear(s);
+        delete[] s.prof;
+        s.prof = 0;
+    }
+}
+
+void hart_profile_visit(const Hart& h, void (*fn)(void* ctx, uint32_t pc, uint64_t insns, uint64_t cycles), void* ctx) {
+    if (!h.sim || !h.sim->prof) return;
+    for (unsigned p = 0; p < (RAM_SIZE >> RAM_PAGE_SHIFT); p++) {
+        const ProfilePage* pg = h.sim->prof[p];
+        if (!pg) continue;
+        for (unsigned i = 0; i < (1u << RAM_PAGE_SHIFT); i++) {
+            if (pg->insns[i] == 0 && pg->cycles[i] == 0) continue;
+            unsigned idx = (p << RAM_PAGE_SHIFT) + i;
+            fn(ctx, DRAM_BASE + idx * 4, pg->insns[i], pg->cycles[i]);
+        }
+    }
+}
+
+void hart_call_hook(Hart& h, HartCallHook fn, void* ctx) {
+    if (!h.sim) h.sim = hart_sim_create();
+    h.sim->call_hook = fn;
+    h.sim->call_ctx  = ctx;
+}
+
+void hart_retire_hook(Hart& h, HartRetireHook fn, void* ctx) {
+    if (!h.sim) h.sim = hart_sim_create();
+    h.sim->retire_hook = fn;
+    h.sim->retire_ctx  = ctx;
+}
+
+uint32_t hart_mem_read(const Hart& h, const volatile uint32_t* ram, unsigned idx) {
+    if (ENABLE_DCACHE) {
+        unsigned line = idx / DCACHE_LINE_WORDS;
+        unsigned set  = line % DCACHE_SETS;
+        for (int w = 0; w < DCACHE_WAYS; w++) {
+            if (h.dcache_valid[w][set] && h.dcache_tag[w][set] == line / DCACHE_SETS) {
+                return (uint32_t)h.dcache_data[w][set * DCACHE_LINE_WORDS + idx % DCACHE_LINE_WORDS];
+            }
+        }
+    }
+    return ram[idx];
+}
+
+void hart_stop(Hart& h) {
+    if (h.sim) h.sim->stop = true;
+}
+
+void hart_free(Hart& h) {
+    if (!h.sim) return;
+    uart_finish(*h.sim);
+    hart_profile(h, false);
+    jit_destroy(h.sim->jit_cache);
+    delete h.sim;
+    h.sim = 0;
+}
+#endif
+
 // ------------------------------------------------------------
 // Helper Functions: Immediate Extractors
 // ------------------------------------------------------------
-ap_int<32> sextI(ap_uint<32> insn) {
+sword_t sextI(uword_t insn) {
     #pragma HLS INLINE
-    ap_int<12> imm12 = (ap_int<12>)(insn >> 20);
-    return (ap_int<32>)imm12;
+    return sext<12>(insn >> 20);
 }
 
-ap_int<32> sextS(ap_uint<32> insn) {
+sword_t sextS(uword_t insn) {
     #pragma HLS INLINE
-    ap_uint<7> hi = insn.range(31,25);
-    ap_uint<5> lo = insn.range(11,7);
-    ap_uint<12> u = ((ap_uint<12>)hi << 5) | (ap_uint<12>)lo;
-    ap_int<12> s = (ap_int<12>)u;
-    return (ap_int<32>)s;
+    uword_t u = (bits<31,25>(insn) << 5) | bits<11,7>(insn);
+    return sext<12>(u);
 }
 
-ap_int<32> sextB(ap_uint<32> insn) {
+sword_t sextB(uword_t insn) {
     #pragma HLS INLINE
-    ap_uint<13> imm;
-    imm[12]       = insn[31];       
-    imm[11]       = insn[7];        
-    imm.range(10,5) = insn.range(30,25); 
-    imm.range(4,1)  = insn.range(11,8);  
-    imm[0]          = 0;            
-    return (ap_int<32>)((ap_int<13>)imm);
+    uword_t u = (bits<31,31>(insn) << 12) |
+                    (bits<7,7>(insn)   << 11) |
+                    (bits<30,25>(insn) << 5 ) |
+                    (bits<11,8>(insn)  << 1 );
+    return sext<13>(u);
 }
 
-ap_int<32> sextJ(ap_uint<32> insn) {
+sword_t sextJ(uword_t insn) {
     #pragma HLS INLINE
-    ap_uint<21> u = ((ap_uint<21>)insn[31]        << 20) |
-                    ((ap_uint<21>)insn.range(30,21) << 1 ) |
-                    ((ap_uint<21>)insn[20]        << 11) |
-                    ((ap_uint<21>)insn.range(19,12) << 12);
-    ap_int<21> s = (ap_int<21>)u;
-    return (ap_int<32>)s;
+    uword_t u = (bits<31,31>(insn) << 20) |
+                    (bits<30,21>(insn) << 1 ) |
+                    (bits<20,20>(insn) << 11) |
+                    (bits<19,12>(insn) << 12);
+    return sext<21>(u);
 }
 
 // ------------------------------------------------------------
 // CSR Read/Write Helpers
 // ------------------------------------------------------------
-ap_uint<32> csr_read(unsigned addr) {
+uword_t csr_read(Hart& h, unsigned addr) {
     #pragma HLS INLINE
     switch (addr) {
         // Machine Information
@@ -214,52 +829,52 @@ ap_uint<32> csr_read(unsigned addr) {
         // Machine ISA
         case 0x301: return 0x40001101;                                 // misa: RV32IMA
         // Machine Trap Setup
-        case 0x300: return csr_mstatus;                                // mstatus
-        case 0x302: return csr_medeleg;                                // medeleg
-        case 0x303: return csr_mideleg;                                // mideleg
-        case 0x304: return csr_mie;                                    // mie
-        case 0x305: return csr_mtvec;                                  // mtvec
-        case 0x320: return csr_mcountinhibit;                          // mcountinhibit
+        case 0x300: return h.csr_mstatus;                                // mstatus
+        case 0x302: return h.csr_medeleg;                                // medeleg
+        case 0x303: return h.csr_mideleg;                                // mideleg
+        case 0x304: return h.csr_mie;                                    // mie
+        case 0x305: return h.csr_mtvec;                                  // mtvec
+        case 0x320: return h.csr_mcountinhibit;                          // mcountinhibit
         // Machine Trap Handling
-        case 0x340: return csr_mscratch;                               // mscratch
-        case 0x341: return csr_mepc;                                   // mepc
-        case 0x342: return csr_mcause;                                 // mcause
-        case 0x343: return csr_mtval;                                  // mtval
-        case 0x344: return csr_mip;                                    // mip
+        case 0x340: return h.csr_mscratch;                               // mscratch
+        case 0x341: return h.csr_mepc;                                   // mepc
+        case 0x342: return h.csr_mcause;                                 // mcause
+        case 0x343: return h.csr_mtval;                                  // mtval
+        case 0x344: return mip_read(h);                                  // mip
         // Machine Counters
-        case 0xB00: return (ap_uint<32>)csr_mcycle;                    // mcycle (low)
-        case 0xB80: return (ap_uint<32>)(csr_mcycle >> 32);            // mcycleh (high)
-        case 0xB02: return (ap_uint<32>)csr_minstret;                  // minstret (low)
-        case 0xB82: return (ap_uint<32>)(csr_minstret >> 32);          // minstreth (high)
+        case 0xB00: return (uword_t)h.csr_mcycle;                    // mcycle (low)
+        case 0xB80: return (uword_t)(h.csr_mcycle >> 32);            // mcycleh (high)
+        case 0xB02: return (uword_t)h.csr_minstret;                  // minstret (low)
+        case 0xB82: return (uword_t)(h.csr_minstret >> 32);          // minstreth (high)
         // User Counter Aliases (read-only mirrors)
-        case 0xC00: return (ap_uint<32>)csr_mcycle;                    // cycle
-        case 0xC80: return (ap_uint<32>)(csr_mcycle >> 32);            // cycleh
-        case 0xC02: return (ap_uint<32>)csr_minstret;                  // instret
-        case 0xC82: return (ap_uint<32>)(csr_minstret >> 32);          // instreth
+        case 0xC00: return (uword_t)h.csr_mcycle;                    // cycle
+        case 0xC80: return (uword_t)(h.csr_mcycle >> 32);            // cycleh
+        case 0xC02: return (uword_t)h.csr_minstret;                  // instret
+        case 0xC82: return (uword_t)(h.csr_minstret >> 32);          // instreth
         // S-mode (sinks)
-        case 0x180: return csr_satp;                                   // satp
+        case 0x180: return h.csr_satp;                                   // satp
         default:    return 0;
     }
 }
 
-void csr_write(unsigned addr, ap_uint<32> val) {
+void csr_write(Hart& h, unsigned addr, uword_t val) {
     #pragma HLS INLINE
     switch (addr) {
         // Machine Trap Setup
-        case 0x300: csr_mstatus = val; break;        // mstatus
-        case 0x302: csr_medeleg = val; break;         // medeleg (sink)
-        case 0x303: csr_mideleg = val; break;         // mideleg (sink)
-        case 0x304: csr_mie = val; break;             // mie
-        case 0x305: csr_mtvec = val; break;           // mtvec
-        case 0x320: csr_mcountinhibit = val; break;   // mcountinhibit (sink)
+        case 0x300: h.csr_mstatus = val; irq_schedule(h); break; // mstatus
+        case 0x302: h.csr_medeleg = val; break;         // medeleg (sink)
+        case 0x303: h.csr_mideleg = val; break;         // mideleg (sink)
+        case 0x304: h.csr_mie = val; irq_schedule(h); break;     // mie
+        case 0x305: h.csr_mtvec = val; break;           // mtvec
+        case 0x320: h.csr_mcountinhibit = val; break;   // mcountinhibit (sink)
         // Machine Trap Handling
-        case 0x340: csr_mscratch = val; break;        // mscratch
-        case 0x341: csr_mepc = val; break;            // mepc
-        case 0x342: csr_mcause = val; break;          // mcause
-        case 0x343: csr_mtval = val; break;           // mtval
-        case 0x344: csr_mip = val; break;             // mip
+        case 0x340: h.csr_mscratch = val; break;        // mscratch
+        case 0x341: h.csr_mepc = val; break;            // mepc
+        case 0x342: h.csr_mcause = val; break;          // mcause
+        case 0x343: h.csr_mtval = val; break;           // mtval
+        case 0x344: h.csr_mip = val; irq_schedule(h); break;     // mip
         // S-mode (sinks)
-        case 0x180: csr_satp = val; break;            // satp (sink)
+        case 0x180: h.csr_satp = val; break;            // satp (sink)
         // Read-only CSRs (misa, mhartid, counters) — silently ignore writes
         default: break;
     }
@@ -268,26 +883,26 @@ void csr_write(unsigned addr, ap_uint<32> val) {
 // ------------------------------------------------------------
 // Stage: Fetch
 // ------------------------------------------------------------
-FetchOut fetch(volatile uint32_t* ram) {
+FetchOut fetch(Hart& h, volatile uint32_t* ram) {
     #pragma HLS INLINE
     FetchOut f;
     
-    unsigned im_idx = addr_to_idx((unsigned)pc);
+    unsigned im_idx = addr_to_idx((unsigned)h.pc);
     
     #ifdef __SYNTHESIS__
-        f.instr = (ap_uint<32>)ram[im_idx];
+        f.instr = ENABLE_ICACHE ? icache_read(h, ram, im_idx) : (uword_t)ram[im_idx];
     #else
         if (im_idx < RAM_SIZE) {
-            f.instr = (ap_uint<32>)ram[im_idx];
+            f.instr = ENABLE_ICACHE ? icache_read(h, ram, im_idx) : (uword_t)ram[im_idx];
         } else {
             f.instr = 0; 
         }
     #endif
-    f.pc = pc;
+    f.pc = h.pc;
 
-    if(CORE_DEBUG) {
+    if(CORE_LOG) {
         std::cout << "\n------------------------------------------------------------\n";
-        std::cout << "[FETCH] PC=0x" << std::hex << (unsigned)pc 
+        std::cout << "[FETCH] PC=0x" << std::hex << (unsigned)h.pc 
                   << " Instr=0x" << (unsigned)f.instr << std::dec << "\n";
     }
     return f;
@@ -296,17 +911,17 @@ FetchOut fetch(volatile uint32_t* ram) {
 // ------------------------------------------------------------
 // Stage: Decode
 // ------------------------------------------------------------
-DecodeOut decode(const FetchOut& f) {
+DecodeOut decode(Hart& h, const FetchOut& f) {
     #pragma HLS INLINE
     DecodeOut d;
-    ap_uint<32> instr = f.instr;
-
-    d.opcode = instr.range(6, 0);
-    d.rd     = instr.range(11, 7);
-    d.funct3 = instr.range(14, 12);
-    d.rs1    = instr.range(19, 15);
-    d.rs2    = instr.range(24, 20);
-    d.funct7 = instr.range(31, 25);
+    uword_t instr = f.instr;
+
+    d.opcode = bits<6, 0>(instr);
+    d.rd     = bits<11, 7>(instr);
+    d.funct3 = bits<14, 12>(instr);
+    d.rs1    = bits<19, 15>(instr);
+    d.rs2    = bits<24, 20>(instr);
+    d.funct7 = bits<31, 25>(instr);
     d.instr  = instr;
 
     // Uniform Switch for Immediate Extraction
@@ -319,23 +934,52 @@ DecodeOut decode(const FetchOut& f) {
     }
     
     d.pc = f.pc;
-    d.rs1_val = (d.rs1 == 0) ? (ap_int<32>)0 : regfile[d.rs1];
-    d.rs2_val = (d.rs2 == 0) ? (ap_int<32>)0 : regfile[d.rs2];
+    d.rs1_val = (d.rs1 == 0) ? (sword_t)0 : h.regfile[d.rs1];
+    d.rs2_val = (d.rs2 == 0) ? (sword_t)0 : h.regfile[d.rs2];
 
-    if (CORE_DEBUG) {
+    if (CORE_LOG) {
         std::cout << "[DECODE] Opcode=0x" << std::hex << (int)d.opcode 
                   << " Rd=" << (int)d.rd << std::dec << "\n";
     }
     return d;
 }
 
+#ifndef __SYNTHESIS__
+// ------------------------------------------------------------
+// Fetch + Decode through the Predecode Cache (C-Sim Only)
+// ------------------------------------------------------------
+DecodeOut fetch_decode_cached(Hart& h, volatile uint32_t* ram) {
+    HartSim& s = *h.sim;
+    unsigned im_idx = addr_to_idx((unsigned)h.pc);
+
+    // Debug runs keep the per-stage log; out-of-range fetches are never cached
+    if (!ENABLE_PREDECODE_CACHE || CORE_LOG || im_idx >= RAM_SIZE) {
+        return decode(h, fetch(h, ram));
+    }
+
+    PredecodeEntry& p = s.predecode_cache[im_idx & (PREDECODE_ENTRIES - 1)];
+    if (p.gen != s.predecode_gen || p.idx != im_idx) {
+        p.d   = decode(h, fetch(h, ram));
+        p.idx = im_idx;
+        p.gen = s.predecode_gen;
+        return p.d;
+    }
+
+    DecodeOut d = p.d;
+    d.pc = h.pc;
+    d.rs1_val = (d.rs1 == 0) ? (sword_t)0 : h.regfile[d.rs1];
+    d.rs2_val = (d.rs2 == 0) ? (sword_t)0 : h.regfile[d.rs2];
+    return d;
+}
+#endif
+
 // ------------------------------------------------------------
 // Stage: Execute
 // ------------------------------------------------------------
-ExecOut execute(const DecodeOut& d) {
+ExecOut execute(Hart& h, const DecodeOut& d) {
     #pragma HLS INLINE
-    ap_int<32> rs1_val = d.rs1_val;
-    ap_int<32> rs2_val = d.rs2_val;
+    sword_t rs1_val = d.rs1_val;
+    sword_t rs2_val = d.rs2_val;
 
     ExecOut e;
     e.alu_result   = 0;
@@ -351,13 +995,14 @@ ExecOut execute(const DecodeOut& d) {
     e.branch_taken = false;
     e.next_pc      = 0;
     e.finished     = false;
+    e.fence_i      = false;
 
     switch ((unsigned)d.opcode) {
     case 0x2F: { // A-Extension (Atomics)
         if (ENABLE_A_EXTENSION) {
             if (d.funct3 == 0x2) {
                 e.is_atomic  = true;
-                e.atomic_op  = d.funct7.range(6, 2);
+                e.atomic_op  = bits<6, 2>((uword_t)d.funct7);
                 e.alu_result = rs1_val; // Memory Address
                 e.store_val  = rs2_val;
                 e.reg_write  = true;
@@ -370,18 +1015,18 @@ ExecOut execute(const DecodeOut& d) {
         break;
     }
     case 0x33: { // R-type
-            ap_uint<5> shamt = rs2_val.range(4,0);
+            shamt_t shamt = bits<4,0>((uword_t)rs2_val);
             e.reg_write = true;
             
             switch ((unsigned)d.funct7) {
                 case 0x00:
                     switch ((unsigned)d.funct3) {
-                        case 0x0: e.alu_result = rs1_val + rs2_val; break; // ADD
-                        case 0x1: e.alu_result = rs1_val << shamt;  break; // SLL
+                        case 0x0: e.alu_result = wrap_add(rs1_val, rs2_val); break; // ADD
+                        case 0x1: e.alu_result = (sword_t)((uword_t)rs1_val << shamt); break; // SLL
                         case 0x2: e.alu_result = (rs1_val < rs2_val) ? 1 : 0; break; // SLT
-                        case 0x3: e.alu_result = ((ap_uint<32>)rs1_val < (ap_uint<32>)rs2_val) ? 1 : 0; break; // SLTU
+                        case 0x3: e.alu_result = ((uword_t)rs1_val < (uword_t)rs2_val) ? 1 : 0; break; // SLTU
                         case 0x4: e.alu_result = rs1_val ^ rs2_val; break; // XOR
-                        case 0x5: e.alu_result = (ap_uint<32>)rs1_val >> shamt; break; // SRL
+                        case 0x5: e.alu_result = (sword_t)((uword_t)rs1_val >> shamt); break; // SRL
                         case 0x6: e.alu_result = rs1_val | rs2_val; break; // OR
                         case 0x7: e.alu_result = rs1_val & rs2_val; break; // AND
                         default:  e.reg_write = false; e.is_trap = true; break; 
@@ -389,7 +1034,7 @@ ExecOut execute(const DecodeOut& d) {
                     break;
                 case 0x20:
                     switch ((unsigned)d.funct3) {
-                        case 0x0: e.alu_result = rs1_val - rs2_val; break; // SUB
+                        case 0x0: e.alu_result = wrap_sub(rs1_val, rs2_val); break; // SUB
                         case 0x5: e.alu_result = rs1_val >> shamt; break; // SRA
                         default:  e.reg_write = false; e.is_trap = true; break;
                     }
@@ -404,46 +1049,46 @@ ExecOut execute(const DecodeOut& d) {
                         bool is_div_op = is_div || is_divu || is_rem || is_remu;
                         bool is_signed = is_div || is_rem;
 
-                        bool sign_a = rs1_val[31];
-                        bool sign_b = rs2_val[31];
+                        bool sign_a = bit<31>((uword_t)rs1_val);
+                        bool sign_b = bit<31>((uword_t)rs2_val);
                         
-                        ap_uint<32> u_a = (is_signed && sign_a) ? (ap_uint<32>)(-rs1_val) : (ap_uint<32>)rs1_val;
-                        ap_uint<32> u_b = (is_signed && sign_b) ? (ap_uint<32>)(-rs2_val) : (ap_uint<32>)rs2_val;
+                        uword_t u_a = (is_signed && sign_a) ? (uword_t)(0 - (uword_t)rs1_val) : (uword_t)rs1_val;
+                        uword_t u_b = (is_signed && sign_b) ? (uword_t)(0 - (uword_t)rs2_val) : (uword_t)rs2_val;
 
-                        ap_uint<32> u_quot = 0;
-                        ap_uint<32> u_rem  = 0;
+                        uword_t u_quot = 0;
+                        uword_t u_rem  = 0;
 
                         if (is_div_op) {
                             if (u_b != 0) {
                                 u_quot = u_a / u_b;
-                                u_rem = u_a - (u_quot * u_b);
+                                u_rem = (uword_t)(u_a - (uword_t)(u_quot * u_b));
                             } else {
-                                u_quot = -1;
+                                u_quot = 0xFFFFFFFF;
                                 u_rem  = u_a;
                             }
                         }
 
-                        ap_int<32> res_div = 0;
-                        ap_int<32> res_rem = 0;
+                        sword_t res_div = 0;
+                        sword_t res_rem = 0;
 
                         if (is_signed) {
-                            res_div = ((sign_a ^ sign_b) && u_b != 0) ? (ap_int<32>)-u_quot : (ap_int<32>)u_quot;
-                            res_rem = (sign_a && u_b != 0) ? (ap_int<32>)-u_rem : (ap_int<32>)u_rem;
+                            res_div = ((sign_a ^ sign_b) && u_b != 0) ? (sword_t)(uword_t)(0 - u_quot) : (sword_t)u_quot;
+                            res_rem = (sign_a && u_b != 0) ? (sword_t)(uword_t)(0 - u_rem) : (sword_t)u_rem;
                             
-                            if (u_b == 1 && sign_b && !sign_a && rs1_val == (ap_int<32>)0x80000000) {
+                            if (u_b == 1 && sign_b && !sign_a && rs1_val == (sword_t)0x80000000) {
                                 res_div = rs1_val;
                                 res_rem = 0;
                             }
                         } else {
-                            res_div = (ap_int<32>)u_quot;
-                            res_rem = (ap_int<32>)u_rem;
+                            res_div = (sword_t)u_quot;
+                            res_rem = (sword_t)u_rem;
                         }
 
                         switch ((unsigned)d.funct3) {
-                            case 0x0: e.alu_result = rs1_val * rs2_val; break; // MUL
-                            case 0x1: e.alu_result = (ap_int<32>)(((ap_int<64>)rs1_val * (ap_int<64>)rs2_val) >> 32); break; // MULH
-                            case 0x2: e.alu_result = (ap_int<32>)(((ap_int<64>)rs1_val * (ap_uint<64>)((ap_uint<32>)rs2_val)) >> 32); break; // MULHSU
-                            case 0x3: e.alu_result = (ap_int<32>)(((ap_uint<64>)((ap_uint<32>)rs1_val) * (ap_uint<64>)((ap_uint<32>)rs2_val)) >> 32); break; // MULHU
+                            case 0x0: e.alu_result = (sword_t)(uword_t)((uword_t)rs1_val * (uword_t)rs2_val); break; // MUL
+                            case 0x1: e.alu_result = (sword_t)(((sdword_t)rs1_val * (sdword_t)rs2_val) >> 32); break; // MULH
+                            case 0x2: e.alu_result = (sword_t)(((sdword_t)rs1_val * (udword_t)((uword_t)rs2_val)) >> 32); break; // MULHSU
+                            case 0x3: e.alu_result = (sword_t)(((udword_t)((uword_t)rs1_val) * (udword_t)((uword_t)rs2_val)) >> 32); break; // MULHU
                             case 0x4: e.alu_result = res_div; break; // DIV
                             case 0x5: e.alu_result = res_div; break; // DIVU
                             case 0x6: e.alu_result = res_rem; break; // REM
@@ -462,8 +1107,8 @@ ExecOut execute(const DecodeOut& d) {
             break;
     }
     case 0x17: { // AUIPC
-            ap_int<32> imm20 = (ap_int<32>)(d.instr & 0xFFFFF000);
-            e.alu_result = (ap_int<32>)d.pc + imm20;
+            sword_t imm20 = (sword_t)(d.instr & 0xFFFFF000);
+            e.alu_result = wrap_add(d.pc, imm20);
             e.reg_write  = (d.rd != 0);
             break;
     }
@@ -473,16 +1118,16 @@ ExecOut execute(const DecodeOut& d) {
             } else {
                 e.reg_write = true; 
             }
-            ap_uint<5> shamt = d.imm.range(4,0); 
+            shamt_t shamt = bits<4,0>((uword_t)d.imm); 
             
             switch ((unsigned)d.funct3) {
-                case 0x0: e.alu_result = rs1_val + d.imm; break; // ADDI
-                case 0x1: e.alu_result = rs1_val << shamt;  break; // SLLI
+                case 0x0: e.alu_result = wrap_add(rs1_val, d.imm); break; // ADDI
+                case 0x1: e.alu_result = (sword_t)((uword_t)rs1_val << shamt); break; // SLLI
                 case 0x2: e.alu_result = (rs1_val < d.imm) ? 1 : 0; break; // SLTI
-                case 0x3: e.alu_result = ((ap_uint<32>)rs1_val < (ap_uint<32>)d.imm) ? 1 : 0; break; // SLTIU
+                case 0x3: e.alu_result = ((uword_t)rs1_val < (uword_t)d.imm) ? 1 : 0; break; // SLTIU
                 case 0x4: e.alu_result = rs1_val ^ d.imm; break; // XORI
                 case 0x5: 
-                    if (d.instr[30] == 0) e.alu_result = (ap_uint<32>)rs1_val >> shamt; // SRLI
+                    if (bit<30>(d.instr) == 0) e.alu_result = (sword_t)((uword_t)rs1_val >> shamt); // SRLI
                     else e.alu_result = rs1_val >> shamt; // SRAI
                     break;
                 case 0x6: e.alu_result = rs1_val | d.imm; break; // ORI
@@ -492,18 +1137,18 @@ ExecOut execute(const DecodeOut& d) {
             break;
     }
     case 0x03: { // Load
-            e.alu_result = rs1_val + d.imm;
+            e.alu_result = wrap_add(rs1_val, d.imm);
             e.mem_read   = true;
             e.reg_write  = true;
             break;
     }
     case 0x23: { // Store
-            e.alu_result = rs1_val + d.imm;
+            e.alu_result = wrap_add(rs1_val, d.imm);
             e.mem_write  = true;
             break;
     }
     case 0x63: { // Branch
-            ap_int<32> tgt = (ap_int<32>)d.pc + d.imm;
+            sword_t tgt = wrap_add(d.pc, d.imm);
             bool taken = false;
             
             switch ((unsigned)d.funct3) {
@@ -511,51 +1156,58 @@ ExecOut execute(const DecodeOut& d) {
                 case 0x1: taken = (rs1_val != rs2_val); break; // BNE
                 case 0x4: taken = (rs1_val < rs2_val);  break; // BLT
                 case 0x5: taken = (rs1_val >= rs2_val); break; // BGE
-                case 0x6: taken = ((ap_uint<32>)rs1_val < (ap_uint<32>)rs2_val);  break; // BLTU
-                case 0x7: taken = ((ap_uint<32>)rs1_val >= (ap_uint<32>)rs2_val); break; // BGEU
+                case 0x6: taken = ((uword_t)rs1_val < (uword_t)rs2_val);  break; // BLTU
+                case 0x7: taken = ((uword_t)rs1_val >= (uword_t)rs2_val); break; // BGEU
                 default:  taken = false; break;
             }
 
             if(taken) {
-                e.next_pc = (ap_uint<32>)tgt;
+                e.next_pc = (uword_t)tgt;
                 e.branch_taken = true;
             }
             break;
     }
     case 0x6F: { // JAL
-            e.alu_result    = (ap_int<32>)(d.pc + 4);
-            e.next_pc       = (ap_uint<32>)((ap_int<32>)d.pc + d.imm);
+            e.alu_result    = wrap_add(d.pc, 4);
+            e.next_pc       = (uword_t)wrap_add(d.pc, d.imm);
             e.branch_taken  = true;
             e.reg_write     = (d.rd != 0);
+            #ifndef __SYNTHESIS__
+            call_jump(h, (unsigned)d.rd, 0, (unsigned)d.pc, (unsigned)e.next_pc);
+            #endif
             break;
     }
     case 0x67: { // JALR
-            e.alu_result    = (ap_int<32>)(d.pc + 4); 
-            e.next_pc       = (ap_uint<32>)(((ap_int<32>)rs1_val + d.imm) & (~1));
+            e.alu_result    = wrap_add(d.pc, 4); 
+            e.next_pc       = (uword_t)wrap_add(rs1_val, d.imm) & (uword_t)0xFFFFFFFE;
             e.branch_taken  = true;
             e.reg_write     = (d.rd != 0);
+            #ifndef __SYNTHESIS__
+            call_jump(h, (unsigned)d.rd, (unsigned)d.rs1, (unsigned)d.pc, (unsigned)e.next_pc);
+            #endif
             break;
     }
     case 0x37:{ // LUI
-            e.alu_result = (ap_int<32>)(d.instr & 0xFFFFF000);
+            e.alu_result = (sword_t)(d.instr & 0xFFFFF000);
             e.reg_write  = (d.rd != 0);
             break;
     }
     case 0x73: { // System
-        unsigned csr_addr = d.imm.range(11,0); 
-        ap_uint<5> rs1_imm = d.rs1; 
-        ap_uint<32> trap_cause = 0;
+        unsigned csr_addr = (unsigned)bits<11,0>((uword_t)d.imm); 
+        regidx_t rs1_imm = d.rs1; 
+        uword_t trap_cause = 0;
         
-        ap_uint<32> csr_read_val = csr_read(csr_addr);
+        uword_t csr_read_val = csr_read(h, csr_addr);
         
         e.reg_write = false; 
 
         switch ((unsigned)d.funct3) {
             case 0x0: // ECALL / EBREAK / WFI / MRET
                 if (d.imm == 0x000) { 
-                    if (regfile[17] == 93) {
+                    if (h.regfile[17] == 93) {
                         e.finished = true;
                         #ifndef __SYNTHESIS__
+                        uart_finish(*h.sim);
                         std::cout << "[CORE DEBUG] Exit Condition Met! Stopping Simulation." << std::endl;
                         #endif
                     }
@@ -564,66 +1216,58 @@ ExecOut execute(const DecodeOut& d) {
                 } // ECALL
                 else if (d.imm == 0x001) { e.is_trap = true; trap_cause = 3; } // EBREAK
                 else if (d.imm == 0x105) { // WFI (Wait For Interrupt)
-                    #ifndef __SYNTHESIS__
-                    bool global_enable = (csr_mstatus >> 3) & 1;
-                    bool timer_enable  = (csr_mie >> 7) & 1;
-
-                    if (csr_mcycle > 500000) { 
-                        mtimecmp = csr_mcycle + 100;
-                        
-                        std::cout << "[SIM-HACK] WFI at Cycle " << std::hex << (uint64_t)csr_mcycle 
-                                  << " | MIE (Global): " << (int)global_enable 
-                                  << " | MTIE (Timer): " << (int)timer_enable 
-                                  << std::dec << std::endl << std::flush;
-                    }
-                    #endif
+                    // NOP here; C-sim skips the idle time in hart_step (wfi_idle)
                 }
                 else if (d.imm == 0x302) { // MRET
-                    e.next_pc = (ap_uint<32>)csr_mepc;
+                    e.next_pc = (uword_t)h.csr_mepc;
                     e.branch_taken = true;
 
-                    bool mpie = (csr_mstatus >> 7) & 1;
-                    if(mpie) csr_mstatus |= (1 << 3);
-                    else     csr_mstatus &= ~(1 << 3);
-                    csr_mstatus |= (1 << 7);
+                    bool mpie = (h.csr_mstatus >> 7) & 1;
+                    if(mpie) h.csr_mstatus |= (1 << 3);
+                    else     h.csr_mstatus &= ~(1 << 3);
+                    h.csr_mstatus |= (1 << 7);
+                    irq_schedule(h);
+                    #ifndef __SYNTHESIS__
+                    call_event(h, HART_TRAP_RETURN, (unsigned)d.pc, (unsigned)e.next_pc);
+                    #endif
 
                     e.reg_write = false; 
-                    if(CORE_DEBUG) std::cout << "[MRET] Returning to 0x" << std::hex << (int)e.next_pc << std::dec << "\n";
+                    if(CORE_LOG) std::cout << "[MRET] Returning to 0x" << std::hex << (int)e.next_pc << std::dec << "\n";
                 }
                 break;
             case 0x1: // CSRRW
                 e.alu_result = csr_read_val; 
                 e.reg_write = (d.rd != 0);
-                csr_write(csr_addr, (ap_uint<32>)rs1_val);
+                csr_write(h, csr_addr, (uword_t)rs1_val);
                 break;
             case 0x2: // CSRRS
                 e.alu_result = csr_read_val; 
                 e.reg_write = (d.rd != 0);
                 if (d.rs1 != 0)
-                    csr_write(csr_addr, csr_read_val | (ap_uint<32>)rs1_val);
+                    csr_write(h, csr_addr, csr_read_val | (uword_t)rs1_val);
                 break;
             case 0x3: // CSRRC
                 e.alu_result = csr_read_val;
                 e.reg_write = (d.rd != 0);
                 if (d.rs1 != 0)
-                    csr_write(csr_addr, csr_read_val & ~(ap_uint<32>)rs1_val);
+                    csr_write(h, csr_addr, csr_read_val & ~(uword_t)rs1_val);
                 break;
             case 0x5: // CSRRWI
                 e.alu_result = csr_read_val; 
                 e.reg_write = (d.rd != 0);
-                csr_write(csr_addr, (ap_uint<32>)rs1_imm);
+                csr_write(h, csr_addr, (uword_t)rs1_imm);
                 break;
             case 0x6: // CSRRSI
                 e.alu_result = csr_read_val;
                 e.reg_write = (d.rd != 0);
                 if (rs1_imm != 0)
-                    csr_write(csr_addr, csr_read_val | (ap_uint<32>)rs1_imm);
+                    csr_write(h, csr_addr, csr_read_val | (uword_t)rs1_imm);
                 break;
             case 0x7: // CSRRCI
                 e.alu_result = csr_read_val;
                 e.reg_write = (d.rd != 0);
                 if (rs1_imm != 0)
-                    csr_write(csr_addr, csr_read_val & ~(ap_uint<32>)rs1_imm);
+                    csr_write(h, csr_addr, csr_read_val & ~(uword_t)rs1_imm);
                 break;
             default:
                 e.is_trap = true;
@@ -632,11 +1276,15 @@ ExecOut execute(const DecodeOut& d) {
         }
 
         if (e.is_trap) {
-            csr_mepc = d.pc;       
-            csr_mcause = trap_cause;  
-            e.next_pc = csr_mtvec;      
+            h.csr_mepc = d.pc;       
+            h.csr_mcause = trap_cause;  
+            mstatus_trap(h);
+            e.next_pc = h.csr_mtvec;      
             e.branch_taken = true; 
             e.reg_write = false; 
+            #ifndef __SYNTHESIS__
+            call_event(h, HART_TRAP, (unsigned)d.pc, (unsigned)e.next_pc);
+            #endif
         }
         break;
     } 
@@ -645,10 +1293,11 @@ ExecOut execute(const DecodeOut& d) {
 
         switch ((unsigned)d.funct3) {
             case 0x1: // FENCE.I
-                if(CORE_DEBUG) std::cout << "[FENCE.I] Synchronizing Instruction Stream\n";
+                if(CORE_LOG) std::cout << "[FENCE.I] Synchronizing Instruction Stream\n";
+                e.fence_i = true; // Carried out by memory(), which owns the caches' RAM port
                 break;
             default: // FENCE
-                if(CORE_DEBUG) std::cout << "[FENCE] Memory Barrier\n";
+                if(CORE_LOG) std::cout << "[FENCE] Memory Barrier\n";
                 break;
         }
         break;
@@ -656,15 +1305,19 @@ ExecOut execute(const DecodeOut& d) {
 
     default:
             e.is_trap = true;
-            csr_mepc = d.pc;       
-            csr_mcause = 2; 
-            e.next_pc = csr_mtvec;     
+            h.csr_mepc = d.pc;       
+            h.csr_mcause = 2; 
+            mstatus_trap(h);
+            e.next_pc = h.csr_mtvec;     
             e.branch_taken = true; 
             e.reg_write = false; 
+            #ifndef __SYNTHESIS__
+            call_event(h, HART_TRAP, (unsigned)d.pc, (unsigned)e.next_pc);
+            #endif
             break;
     }
 
-    if (CORE_DEBUG) {
+    if (CORE_LOG) {
         std::cout << "[EXEC] ALU=0x" << std::hex << (int)e.alu_result << std::dec << "\n";
     }
     return e;
@@ -673,7 +1326,7 @@ ExecOut execute(const DecodeOut& d) {
 // ------------------------------------------------------------
 // Stage: Memory
 // ------------------------------------------------------------
-MemOut memory(volatile uint32_t* ram, const ExecOut& e) {
+MemOut memory(Hart& h, volatile uint32_t* ram, const ExecOut& e) {
     #pragma HLS INLINE
     MemOut m;
     m.is_trap = e.is_trap;
@@ -697,6 +1350,17 @@ MemOut memory(volatile uint32_t* ram, const ExecOut& e) {
     unsigned phys_ea = ea_u & 0x07FFFFFF;        // Used for CLINT MMIO checks
     unsigned d_idx   = addr_to_idx(ea_u);        // Synthesis: ea_u>>2, Sim: array-relative
     unsigned byte_off = ea_u & 0x3;
+    bool     cached   = ENABLE_DCACHE && ea_u >= DRAM_BASE; // UART and CLINT bypass the D-cache
+
+    // FENCE.I: older stores reach RAM before the I-cache refetches (through
+    // the other m_axi port: the write bursts complete before memory() returns)
+    if (e.fence_i) {
+        dcache_flush(h, ram);
+        icache_invalidate(h);
+        #ifndef __SYNTHESIS__
+        code_flush(*h.sim);
+        #endif
+    }
 
     // =============================================================
     // ATOMIC MEMORY OPERATIONS (A-EXTENSION)
@@ -708,54 +1372,56 @@ MemOut memory(volatile uint32_t* ram, const ExecOut& e) {
         } else 
         #endif
         {
-            uint32_t loaded_raw = ram[d_idx];
-            ap_int<32> loaded_val = (ap_int<32>)loaded_raw;
-            ap_int<32> write_val = 0;
+            sword_t loaded_val = (sword_t)dmem_read(h, ram, d_idx, cached);
+            sword_t write_val = 0;
             bool do_write = false;
 
             // Load Reserved (LR.W)
             if (e.atomic_op == 0x02) { 
-                lr_addr = ea_u;
-                lr_valid = true;
+                h.lr_addr = ea_u;
+                h.lr_valid = true;
                 m.value = loaded_val;
                 do_write = false;
-                if(CORE_DEBUG) std::cout << "[AMO] LR at 0x" << std::hex << ea_u << std::dec << "\n";
+                if(CORE_LOG) std::cout << "[AMO] LR at 0x" << std::hex << ea_u << std::dec << "\n";
             } 
             // Store Conditional (SC.W)
             else if (e.atomic_op == 0x03) {
-                if (lr_valid && lr_addr == ea_u) {
+                if (h.lr_valid && h.lr_addr == ea_u) {
                     write_val = e.store_val;
                     do_write = true;
                     m.value = 0; // Success
-                    lr_valid = false;
+                    h.lr_valid = false;
                 } else {
                     do_write = false;
                     m.value = 1; // Failure
                 }
-                if(CORE_DEBUG) std::cout << "[AMO] SC at 0x" << std::hex << ea_u << (do_write ? " Success" : " Fail") << std::dec << "\n";
+                if(CORE_LOG) std::cout << "[AMO] SC at 0x" << std::hex << ea_u << (do_write ? " Success" : " Fail") << std::dec << "\n";
             }
             // AMO Read-Modify-Write Operations
             else {
-                ap_int<32> op_b = e.store_val;
+                sword_t op_b = e.store_val;
                 do_write = true;
                 switch (e.atomic_op) {
                     case 0x01: write_val = op_b; break; // AMOSWAP
-                    case 0x00: write_val = loaded_val + op_b; break; // AMOADD
+                    case 0x00: write_val = wrap_add(loaded_val, op_b); break; // AMOADD
                     case 0x04: write_val = loaded_val ^ op_b; break; // AMOXOR
                     case 0x0C: write_val = loaded_val & op_b; break; // AMOAND
                     case 0x08: write_val = loaded_val | op_b; break; // AMOOR
                     case 0x10: write_val = (loaded_val < op_b) ? loaded_val : op_b; break; // AMOMIN
                     case 0x14: write_val = (loaded_val > op_b) ? loaded_val : op_b; break; // AMOMAX
-                    case 0x18: write_val = ((ap_uint<32>)loaded_val < (ap_uint<32>)op_b) ? loaded_val : op_b; break; // AMOMINU
-                    case 0x1C: write_val = ((ap_uint<32>)loaded_val > (ap_uint<32>)op_b) ? loaded_val : op_b; break; // AMOMAXU
+                    case 0x18: write_val = ((uword_t)loaded_val < (uword_t)op_b) ? loaded_val : op_b; break; // AMOMINU
+                    case 0x1C: write_val = ((uword_t)loaded_val > (uword_t)op_b) ? loaded_val : op_b; break; // AMOMAXU
                     default: do_write = false; break;
                 }
                 m.value = loaded_val; // AMOs write original value to Rd
             }
 
             if (do_write) {
-                ram[d_idx] = (uint32_t)write_val;
-                lr_valid = false; 
+                dmem_write(h, ram, d_idx, (uword_t)write_val, (uword_t)0xFFFFFFFF, cached);
+                h.lr_valid = false; 
+                #ifndef __SYNTHESIS__
+                code_write(*h.sim, d_idx);
+                #endif
             }
         }
     }
@@ -768,9 +1434,9 @@ MemOut memory(volatile uint32_t* ram, const ExecOut& e) {
         // ----------------------------------------------------------------
         if ((ea_u & 0xFFFFF000) == 0x10000000) {
             #ifdef __SYNTHESIS__
-                m.value = (ap_int<32>)ram[d_idx]; // Read from real UART via AXI
+                m.value = (sword_t)ram[d_idx]; // Read from real UART via AXI
             #else
-                m.value = 0x60; // Sim: always "TX Ready"
+                m.value = (ea_u & 0xFF) < 8 ? (sword_t)uart_read(*h.sim, ea_u & 0x7, (uint64_t)h.csr_mcycle) : (sword_t)0;
             #endif
             m.reg_write = true;
             return m;
@@ -781,24 +1447,24 @@ MemOut memory(volatile uint32_t* ram, const ExecOut& e) {
         // ----------------------------------------------------------------
         // mtimecmp (0x2004000) - Timer Compare Register
         if (phys_ea == 0x2004000) {
-            m.value = (ap_int<32>)(mtimecmp & 0xFFFFFFFF);
+            m.value = (sword_t)(h.mtimecmp & 0xFFFFFFFF);
             m.reg_write = true;
             return m;
         }
         if (phys_ea == 0x2004004) {
-            m.value = (ap_int<32>)(mtimecmp >> 32);
+            m.value = (sword_t)(h.mtimecmp >> 32);
             m.reg_write = true;
             return m;
         }
         
         // mtime (0x200BFF8) - Current Time (Aliased to csr_mcycle)
         if (phys_ea == 0x200BFF8) {
-            m.value = (ap_int<32>)(csr_mcycle & 0xFFFFFFFF);
+            m.value = (sword_t)(h.csr_mcycle & 0xFFFFFFFF);
             m.reg_write = true;
             return m;
         }
         if (phys_ea == 0x200BFFC) {
-            m.value = (ap_int<32>)(ap_uint<32>)(csr_mcycle >> 32);
+            m.value = (sword_t)(uword_t)(h.csr_mcycle >> 32);
             m.reg_write = true;
             return m;
         }
@@ -808,27 +1474,30 @@ MemOut memory(volatile uint32_t* ram, const ExecOut& e) {
         // ----------------------------------------------------------------
         #ifndef __SYNTHESIS__
         if (d_idx >= RAM_SIZE) {
-            if(CORE_DEBUG) std::cerr << "[MEM] Load OOB: EA=0x" << std::hex << ea_u << "\n";
+            if(CORE_LOG) std::cerr << "[MEM] Load OOB: EA=0x" << std::hex << ea_u << "\n";
             m.value = 0;
         } else 
         #endif
         {
-            uint32_t raw_w0 = ram[d_idx];
-            uint32_t raw_w1 = (d_idx + 1 < RAM_SIZE) ? (uint32_t)ram[d_idx + 1] : 0;
-
-            ap_uint<32> word0 = (ap_uint<32>)raw_w0;
-            ap_uint<32> word1 = (ap_uint<32>)raw_w1;
-            
-            ap_uint<32> raw_val_32 = (word0 >> (byte_off * 8)) | (word1 << ((4 - byte_off) * 8));
-            ap_int<32> loaded_val = 0;
+            // The second word only when the access continues into it
+            // (LB/LBU never do; funct3[1:0] is log2 of the size)
+            bool    crosses = byte_off + (1u << ((unsigned)e.funct3 & 0x3)) > 4;
+            uword_t word0 = dmem_read(h, ram, d_idx, cached);
+            uword_t word1 = (crosses && d_idx + 1 < RAM_SIZE) ? dmem_read(h, ram, d_idx + 1, cached) : (uword_t)0;
+
+            // Aligned (the common case): a 32-bit shift; only a crossing
+            // access needs the 64-bit funnel
+            uword_t raw_val_32 = crosses ? (uword_t)(((udword_t)word1 << 32 | (udword_t)word0) >> (byte_off * 8))
+                                         : (uword_t)(word0 >> (byte_off * 8));
+            sword_t loaded_val = 0;
             m.reg_write = true;
 
             switch ((unsigned)e.funct3) { 
-                case 0: loaded_val = (ap_int<32>)((ap_int<8>)raw_val_32.range(7, 0)); break; // LB
-                case 1: loaded_val = (ap_int<32>)((ap_int<16>)raw_val_32.range(15, 0)); break; // LH
-                case 2: loaded_val = (ap_int<32>)raw_val_32; break; // LW
-                case 4: loaded_val = (ap_int<32>)((ap_uint<32>)raw_val_32.range(7, 0)); break; // LBU
-                case 5: loaded_val = (ap_int<32>)((ap_uint<32>)raw_val_32.range(15, 0)); break; // LHU
+                case 0: loaded_val = sext<8>(raw_val_32); break; // LB
+                case 1: loaded_val = sext<16>(raw_val_32); break; // LH
+                case 2: loaded_val = (sword_t)raw_val_32; break; // LW
+                case 4: loaded_val = (sword_t)bits<7, 0>(raw_val_32); break; // LBU
+                case 5: loaded_val = (sword_t)bits<15, 0>(raw_val_32); break; // LHU
                 default: m.reg_write = false; break; 
             }
             m.value = loaded_val; 
@@ -839,7 +1508,7 @@ MemOut memory(volatile uint32_t* ram, const ExecOut& e) {
     // =============================================================
     else if (mem_write) {
         // Any standard write invalidates a Load Reservation
-        lr_valid = false;
+        h.lr_valid = false;
         
         // ----------------------------------------------------------------
         // MMIO: UART Write
@@ -847,13 +1516,10 @@ MemOut memory(volatile uint32_t* ram, const ExecOut& e) {
         if ((ea_u & 0xFFFFF000) == 0x10000000) { 
             #ifdef __SYNTHESIS__
                 // Hardware: Direct word write to UART via AXI (no read-modify-write!)
-                ram[d_idx] = (uint32_t)(ap_uint<32>)e.store_val;
+                ram[d_idx] = (uint32_t)(uword_t)e.store_val;
             #else
-                // Simulation: Print character
-                if ((ea_u & 0xFF) == 0x00) {
-                    char c = (char)(e.store_val & 0xFF);
-                    std::cout << c << std::flush; 
-                }
+                // Simulation: device model (console bytes are buffered)
+                if ((ea_u & 0xFF) < 8) uart_write(*h.sim, ea_u & 0x7, (uint8_t)(e.store_val & 0xFF), (uint64_t)h.csr_mcycle);
             #endif
             m.reg_write = false; 
             return m;
@@ -863,13 +1529,15 @@ MemOut memory(volatile uint32_t* ram, const ExecOut& e) {
         // MMIO: CLINT (Timer Compare)
         // ----------------------------------------------------------------
         if (phys_ea == 0x2004000) {
-            mtimecmp = (mtimecmp & 0xFFFFFFFF00000000) | (ap_uint<32>)e.store_val;
-            if(CORE_DEBUG) std::cout << "[CLINT] mtimecmp Low Update: " << std::hex << mtimecmp << std::dec << "\n";
+            h.mtimecmp = (h.mtimecmp & 0xFFFFFFFF00000000) | (udword_t)(uword_t)e.store_val;
+            if(CORE_LOG) std::cout << "[CLINT] mtimecmp Low Update: " << std::hex << h.mtimecmp << std::dec << "\n";
+            irq_schedule(h);
             return m;
         }
         if (phys_ea == 0x2004004) {
-             mtimecmp = (mtimecmp & 0x00000000FFFFFFFF) | ((ap_uint<64>)e.store_val << 32);
-             if(CORE_DEBUG) std::cout << "[CLINT] mtimecmp High Update: " << std::hex << mtimecmp << std::dec << "\n";
+             h.mtimecmp = (h.mtimecmp & 0x00000000FFFFFFFF) | ((udword_t)(uword_t)e.store_val << 32);
+             if(CORE_LOG) std::cout << "[CLINT] mtimecmp High Update: " << std::hex << h.mtimecmp << std::dec << "\n";
+             irq_schedule(h);
              return m;
         }
 
@@ -878,47 +1546,44 @@ MemOut memory(volatile uint32_t* ram, const ExecOut& e) {
         // ----------------------------------------------------------------
         #ifndef __SYNTHESIS__
         if (d_idx >= RAM_SIZE) {
-            if(CORE_DEBUG) std::cerr << "[MEM] Store OOB: EA=0x" << std::hex << ea_u << "\n";
+            if(CORE_LOG) std::cerr << "[MEM] Store OOB: EA=0x" << std::hex << ea_u << "\n";
         } else 
         #endif
         {
-            // Read-Modify-Write
-            uint32_t raw_w0 = ram[d_idx];
-            ap_uint<32> word0 = (ap_uint<32>)raw_w0;
-            
-            ap_uint<32> store_val = (ap_uint<32>)e.store_val;
-            ap_uint<32> mask0 = 0;
-            ap_uint<32> mask1 = 0;
+            uword_t store_val = (uword_t)e.store_val;
+            uword_t mask0 = 0;
+            uword_t mask1 = 0;
             
             switch ((unsigned)e.funct3) {
                 case 0: // SB
-                    mask0 = 0xFF << (byte_off * 8);
+                    mask0 = (uword_t)0xFF << (byte_off * 8);
                     break;
                 case 1: { // SH
-                    ap_uint<64> full_mask = (ap_uint<64>)0xFFFF << (byte_off * 8);
-                    mask0 = full_mask.range(31, 0);
-                    mask1 = full_mask.range(63, 32);
+                    udword_t full_mask = (udword_t)0xFFFF << (byte_off * 8);
+                    mask0 = (uword_t)full_mask;
+                    mask1 = (uword_t)(full_mask >> 32);
                     break;
                 }
                 case 2: { // SW
-                    ap_uint<64> full_mask = (ap_uint<64>)0xFFFFFFFF << (byte_off * 8);
-                    mask0 = full_mask.range(31, 0);
-                    mask1 = full_mask.range(63, 32);
+                    udword_t full_mask = (udword_t)0xFFFFFFFF << (byte_off * 8);
+                    mask0 = (uword_t)full_mask;
+                    mask1 = (uword_t)(full_mask >> 32);
                     break;
                 }
             }
 
             // Modify Word 0
-            word0 = (word0 & ~mask0) | ((store_val << (byte_off * 8)) & mask0);
-            ram[d_idx] = (uint32_t)word0;
+            dmem_write(h, ram, d_idx, store_val << (byte_off * 8), mask0, cached);
+            #ifndef __SYNTHESIS__
+            code_write(*h.sim, d_idx);
+            #endif
 
             // Modify Word 1 (Boundary Crossing)
             if (mask1 != 0 && d_idx + 1 < RAM_SIZE) {
-                uint32_t raw_w1 = ram[d_idx + 1];
-                ap_uint<32> word1 = (ap_uint<32>)raw_w1;
-                
-                word1 = (word1 & ~mask1) | ((store_val >> ((4-byte_off)*8)) & mask1);
-                ram[d_idx + 1] = (uint32_t)word1; 
+                dmem_write(h, ram, d_idx + 1, store_val >> ((4-byte_off)*8), mask1, cached);
+                #ifndef __SYNTHESIS__
+                code_write(*h.sim, d_idx + 1);
+                #endif
             }
             
             // ----------------------------------------------------------------
@@ -928,13 +1593,14 @@ MemOut memory(volatile uint32_t* ram, const ExecOut& e) {
             if (phys_ea == 0x1000) {
                 unsigned fromhost_idx = d_idx + 16; 
                 if (fromhost_idx < RAM_SIZE) {
-                    ram[fromhost_idx] = 1; 
+                    dmem_write(h, ram, fromhost_idx, (uword_t)1, (uword_t)0xFFFFFFFF, cached);
+                    code_write(*h.sim, fromhost_idx);
                 }
             }
             #endif
             // ----------------------------------------------------------------
             
-            if(CORE_DEBUG) std::cout << "[MEM] Stored 0x" << std::hex << (int)e.store_val << " to 0x" << ea_u << std::dec << "\n";
+            if(CORE_LOG) std::cout << "[MEM] Stored 0x" << std::hex << (int)e.store_val << " to 0x" << ea_u << std::dec << "\n";
         }
     }
     return m;
@@ -943,111 +1609,687 @@ MemOut memory(volatile uint32_t* ram, const ExecOut& e) {
 // ------------------------------------------------------------
 // Stage: Writeback
 // ------------------------------------------------------------
-void writeback(const MemOut& m) {
+void writeback(Hart& h, const MemOut& m) {
     #pragma HLS INLINE
     if (m.reg_write && m.rd != 0 && !m.is_trap) {
-        regfile[m.rd] = m.value;
-        if(CORE_DEBUG) std::cout << "[WB] x" << (int)m.rd << " <= 0x" << std::hex << (int)m.value << std::dec << "\n";
+        h.regfile[m.rd] = m.value;
+        if(CORE_LOG) std::cout << "[WB] x" << (int)m.rd << " <= 0x" << std::hex << (int)m.value << std::dec << "\n";
     }
-    regfile[0] = 0; 
+    h.regfile[0] = 0; 
 }
 
+#ifndef __SYNTHESIS__
 // ------------------------------------------------------------
-// Top-Level Step Function
+// Basic-Block Engine (C-Sim Only)
 // ------------------------------------------------------------
-void riscv_step(volatile uint32_t* ram, int max_cycles, int* cycles_output) {
-    // In hardware, driver must set m_axi base address to 0x0 so the core can
-    // address both DDR (0x80000000) and UART (0x10000000) via SmartConnect routing.
-    #pragma HLS INTERFACE m_axi port=ram offset=off depth=262144 bundle=gmem
-    // Control Parameters
-    #pragma HLS INTERFACE s_axilite port=max_cycles bundle=control
-    #pragma HLS INTERFACE s_axilite port=cycles_output bundle=control
-    // AXI Lite Interface for Control
-    #pragma HLS INTERFACE s_axilite port=return bundle=control
-    #pragma HLS BIND_STORAGE variable=regfile type=ram_2p impl=lutram
+static bool is_block_end(unsigned opcode) {
+    switch (opcode) {
+        case 0x33: case 0x13: case 0x03: case 0x23:
+        case 0x17: case 0x37: case 0x2F:
+            return false;
+        default: // Branch, JAL, JALR, SYSTEM, FENCE, illegal
+            return true;
+    }
+}
+
+static BasicBlock* block_build(Hart& h, volatile uint32_t* ram, unsigned start_idx) {
+    HartSim& s = *h.sim;
+    if (s.block_arena_used + BLOCK_MAX_INSNS > BLOCK_ARENA_SIZE) block_flush(s);
+
+    BasicBlock& b = s.block_table[start_idx & (BLOCK_ENTRIES - 1)];
+    b.gen        = s.block_gen;
+    b.start_idx  = start_idx;
+    b.first      = s.block_arena_used;
+    b.count      = 0;
+    b.next_fall  = 0;
+    b.next_taken = 0;
+    b.taken_pc   = 0;
+    b.hits       = 0;
+    b.jit_tried  = false;
+    b.jit        = 0;
+    b.jit_pc     = 0;
+
+    unsigned idx = start_idx;
+    while (b.count < BLOCK_MAX_INSNS && idx < RAM_SIZE) {
+        FetchOut f;
+        f.instr = ENABLE_ICACHE ? icache_read(h, ram, idx) : (uword_t)ram[idx]; // As fetch() sees it
+        f.pc    = 0; // Filled per use
+        DecodeOut d = decode(h, f);
+
+        // WFI is left to hart_step (idle fast-forward); still code, though
+        if ((unsigned)d.instr == WFI_INSTR) {
+            s.block_code_map[idx >> 5] |= (1u << (idx & 31));
+            idx++;
+            break;
+        }
+
+        s.block_arena[b.first + b.count]    = d;
+        s.block_observes[b.first + b.count] = (d.opcode == 0x03 ||                       // Loads
+                                               d.opcode == 0x23 || d.opcode == 0x2F);    // UART TX timing
+        s.block_code_map[idx >> 5] |= (1u << (idx & 31));
+        b.count++;
+        idx++;
+
+        if (is_block_end((unsigned)d.opcode)) break;
+    }
+
+    // Only the last instruction can trap or redirect (SYSTEM, jumps, illegal
+    // opcodes): call hook events and CSR reads see exact counters
+    if (b.count) s.block_observes[b.first + b.count - 1] = true;
+
+    s.block_arena_used += b.count;
+    if (start_idx < s.block_code_lo) s.block_code_lo = start_idx;
+    if (idx - 1 > s.block_code_hi)   s.block_code_hi = idx - 1;
+    return &b;
+}
+
+static bool block_matches(HartSim& s, const BasicBlock* b, unsigned idx) {
+    return b && b->gen == s.block_gen && b->start_idx == idx;
+}
+
+// ------------------------------------------------------------
+// JIT Glue (C-Sim Only)
+// ------------------------------------------------------------
+// Translated code reads/writes regfile in place, so the JIT is only used
+// when sword_t is stored as a plain int32_t. Loads, stores and the
+// M-extension ops it does not inline go back through memory()/execute().
+// MMIO (UART, CLINT) is never touched from translated code.
+static bool is_sim_mmio(unsigned ea) {
+    unsigned phys = ea & 0x07FFFFFF;
+    return (ea & 0xFFFFF000) == 0x10000000 || (phys >= 0x2000000 && phys < 0x2010000);
+}
+
+static ExecOut jit_mem_op(unsigned addr, unsigned funct3) {
+    ExecOut e;
+    e.alu_result   = (sword_t)addr;
+    e.rd           = 0;
+    e.mem_read     = false;
+    e.mem_write    = false;
+    e.reg_write    = false;
+    e.funct3       = funct3;
+    e.store_val    = 0;
+    e.is_trap      = false;
+    e.is_atomic    = false;
+    e.atomic_op    = 0;
+    e.branch_taken = false;
+    e.next_pc      = 0;
+    e.finished     = false;
+    e.fence_i      = false;
+    return e;
+}
+
+// Helper context is the Hart; its RAM pointer is parked in HartSim::jit_ram
+static uint64_t jit_load(void* ctx, uint32_t addr, uint32_t funct3) {
+    Hart& h = *(Hart*)ctx;
+    if (is_sim_mmio(addr) || addr_to_idx(addr) >= RAM_SIZE) return 1ull << 32;
+    ExecOut e = jit_mem_op(addr, funct3);
+    e.mem_read  = true;
+    e.reg_write = true;
+    MemOut m = memory(h, h.sim->jit_ram, e);
+    return (uint32_t)(uword_t)m.value;
+}
+
+static int jit_store(void* ctx, uint32_t addr, uint32_t val, uint32_t funct3) {
+    Hart& h = *(Hart*)ctx;
+    if (is_sim_mmio(addr) || addr_to_idx(addr) >= RAM_SIZE) return 1;
+    unsigned gen = h.sim->block_gen;
+    ExecOut e = jit_mem_op(addr, funct3);
+    e.mem_write = true;
+    e.store_val = (sword_t)(int32_t)val;
+    memory(h, h.sim->jit_ram, e);
+    return (h.sim->block_gen != gen) ? 2 : 0;
+}
+
+static int32_t jit_alu(void* ctx, uint32_t instr, int32_t a, int32_t b) {
+    Hart& h = *(Hart*)ctx;
+    FetchOut f;
+    f.instr = instr;
+    f.pc    = 0;
+    DecodeOut d = decode(h, f);
+    d.rs1_val = a;
+    d.rs2_val = b;
+    return (int32_t)execute(h, d).alu_result;
+}
+
+static bool jit_probe() {
+    if (sizeof(sword_t) != sizeof(int32_t) || !jit_available()) return false;
+    sword_t w = (sword_t)(int)0x80000001;
+    int32_t probe;
+    memcpy(&probe, (const void*)&w, sizeof(probe));
+    return probe == (int32_t)0x80000001;
+}
+
+// Also creates the hart's code buffer on first use
+static bool jit_usable(HartSim& s) {
+    static const bool host_ok = jit_probe();
+    if (!host_ok || s.jit_failed) return false;
+    if (!s.jit_cache) {
+        s.jit_cache  = jit_create();
+        s.jit_failed = (s.jit_cache == 0);
+    }
+    return s.jit_cache != 0;
+}
+
+static JitFn jit_translate(HartSim& s, const BasicBlock* b, unsigned entry_pc) {
+    JitInsn insns[BLOCK_MAX_INSNS];
+    for (unsigned k = 0; k < b->count; k++) {
+        const DecodeOut& d = s.block_arena[b->first + k];
+        insns[k].instr  = (unsigned)d.instr;
+        insns[k].opcode = (unsigned)d.opcode;
+        insns[k].rd     = (unsigned)d.rd;
+        insns[k].rs1    = (unsigned)d.rs1;
+        insns[k].rs2    = (unsigned)d.rs2;
+        insns[k].funct3 = (unsigned)d.funct3;
+        insns[k].funct7 = (unsigned)d.funct7;
+        insns[k].imm    = (int)d.imm;
+    }
+    JitHelpers h;
+    h.load  = jit_load;
+    h.store = jit_store;
+    h.alu   = jit_alu;
+    return jit_compile(s.jit_cache, insns, b->count, entry_pc, h);
+}
+
+// Runs chained blocks until one cannot be executed without the per-instruction
+// checks in hart_step (timer interrupt, heartbeat, cycle limit); the caller
+// then single-steps. mcycle/minstret are bumped per block and synced before
+// instructions that can read them. Returns true on the exit ECALL.
+static bool run_blocks(Hart& h, volatile uint32_t* imem, volatile uint32_t* dmem, int max_cycles) {
+    HartSim& s = *h.sim;
+    BasicBlock* prev = 0;
+    bool prev_taken  = false;
+
+    while (true) {
+        unsigned idx = addr_to_idx((unsigned)h.pc);
+        if (idx >= RAM_SIZE) return false;
+
+        // ---- Find the block: chained successor first, then the table ----
+        BasicBlock* b = 0;
+        if (prev && prev->gen == s.block_gen) {
+            if (prev_taken) {
+                if (prev->taken_pc == h.pc && block_matches(s, prev->next_taken, idx)) b = prev->next_taken;
+            } else {
+                if (block_matches(s, prev->next_fall, idx)) b = prev->next_fall;
+            }
+        }
+        if (!b) {
+            BasicBlock& slot = s.block_table[idx & (BLOCK_ENTRIES - 1)];
+            b = block_matches(s, &slot, idx) ? &slot : block_build(h, imem, idx);
+            if (prev && prev->gen == s.block_gen) {
+                if (prev_taken) { prev->next_taken = b; prev->taken_pc = h.pc; }
+                else            { prev->next_fall  = b; }
+            }
+        }
+
+        if (b->count == 0) return false; // Starts with WFI
+
+        // ---- Only run if no per-cycle event can land inside the block ----
+        uint64_t c   = (uint64_t)h.csr_mcycle;
+        uint64_t n   = b->count;
+        uint64_t end = c + n;
+        udword_t deadline = h.irq_deadline;
+
+        if (end >= (uint64_t)deadline) return false;
+        if (max_cycles > 0 && end >= (uint64_t)max_cycles) return false;
+        if ((c / 1000000) != (end / 1000000)) return false; // Heartbeat inside block
+
+        // ---- Translated code for hot blocks ----
+        if (CORE_JIT && !s.retire_hook && jit_usable(s)) { // Translated code retires no events
+            if (!b->jit_tried && ++b->hits >= JIT_THRESHOLD) {
+                b->jit       = jit_translate(s, b, (unsigned)h.pc);
+                b->jit_pc    = h.pc;
+                b->jit_tried = true;
+            }
+            if (b->jit && b->jit_pc == h.pc) {
+                uword_t fall_pc = h.pc + 4 * b->count;
+                s.jit_ram = dmem;
+                uint64_t r = b->jit((int32_t*)(void*)h.regfile, (void*)&h);
+                unsigned retired = (unsigned)(r >> 32);
+                // Zero means the first instruction needs the interpreter (e.g. MMIO)
+                if (retired > 0) {
+                    if (s.prof) {
+                        for (unsigned k = 0; k < retired; k++) prof_count(s, (unsigned)h.pc + 4 * k, 1, 1);
+                    }
+                    unsigned jpc   = (unsigned)h.pc + 4 * (retired - 1);
+                    h.pc           = (unsigned)(r & 0xFFFFFFFF);
+                    h.csr_mcycle   = c + retired;
+                    h.csr_minstret = h.csr_minstret + retired;
+                    if (s.call_hook && retired == b->count) {
+                        // Jumps only end blocks; report what execute() would have
+                        const DecodeOut& j = s.block_arena[b->first + retired - 1];
+                        if (j.opcode == 0x6F || j.opcode == 0x67) {
+                            call_jump(h, (unsigned)j.rd, j.opcode == 0x67 ? (unsigned)j.rs1 : 0, jpc, (unsigned)h.pc);
+                        }
+                    }
+                    prev           = b;
+                    prev_taken     = (h.pc != fall_pc);
+                    continue;
+                }
+            }
+        }
+
+        // ---- Execute the block ----
+        unsigned pc0 = (unsigned)h.pc;
+        uint64_t i0 = (uint64_t)h.csr_minstret;
+        unsigned gen = s.block_gen;
+        unsigned first = b->first;
+        unsigned done = 0;
+        ExecOut e;
+        e.finished     = false;
+        e.branch_taken = false;
+
+        for (unsigned k = 0; k < n; k++) {
+            DecodeOut d = s.block_arena[first + k];
+            d.pc = h.pc;
+            d.rs1_val = (d.rs1 == 0) ? (sword_t)0 : h.regfile[d.rs1];
+            d.rs2_val = (d.rs2 == 0) ? (sword_t)0 : h.regfile[d.rs2];
+
+            if (s.block_observes[first + k]) {
+                h.csr_mcycle   = c + k + 1;
+                h.csr_minstret = i0 + k;
+            }
+
+            e = execute(h, d);
+            MemOut m = memory(h, dmem, e);
+            writeback(h, m);
+            if (s.retire_hook) retire_event(s, d, e, m);
+            done++;
+
+            if (e.branch_taken) h.pc = e.next_pc;
+            else                h.pc += 4;
+
+            if (e.finished || e.branch_taken) break;
+            // Code was overwritten or the interrupt was rescheduled: leave the block here
+            if (s.block_gen != gen || h.irq_deadline != deadline || s.stop) break;
+        }
+
+        h.csr_mcycle   = c + done;
+        h.csr_minstret = i0 + done;
+        if (s.prof) {
+            for (unsigned k = 0; k < done; k++) prof_count(s, pc0 + 4 * k, 1, 1);
+        }
+
+        if (e.finished) return true;
+        if (s.stop) return false;
+
+        prev = b;
+        prev_taken = e.branch_taken;
+    }
+}
+#endif
+
+#ifndef __SYNTHESIS__
+// ------------------------------------------------------------
+// WFI Idle Fast-Forward (C-Sim Only)
+// ------------------------------------------------------------
+// The timer is the only interrupt source, so a WFI with nothing pending
+// stalls until mtimecmp. Rather than spinning through the idle loop, mcycle
+// (= mtime) jumps to the cycle before the deadline; the next iteration of
+// hart_step counts the deadline cycle and raises MTIP as usual. minstret is
+// untouched (nothing retires while waiting) and max_cycles still holds.
+static void wfi_idle(Hart& h, unsigned pc, int max_cycles) {
+    uint64_t now = (uint64_t)h.csr_mcycle;
+    uint64_t cmp = (uint64_t)h.mtimecmp;
+    bool pending  = (mip_read(h) & (uword_t)h.csr_mie) != 0;
+    bool timer_en = (h.csr_mie >> 7) & 1;
+
+    // Wakes right away, or never wakes: leave WFI a NOP
+    if (pending || !timer_en || cmp <= now + 1) return;
+    if (cmp == ~0ULL && max_cycles <= 0) return;
+
+    uint64_t target = cmp - 1;
+    if (max_cycles > 0 && target > (uint64_t)max_cycles) target = (uint64_t)max_cycles;
+    if (target <= now) return;
+
+    if (CORE_LOG) {
+        uart_flush(*h.sim);
+        std::cout << "[WFI] Idle " << std::dec << (target - now) << " cycles (" << now
+                  << " -> " << target << ")\n";
+    }
+    h.sim->idle_cycles += target - now;
+    if (h.sim->prof) prof_count(*h.sim, pc, 0, target - now); // Idle time is the WFI's
+    h.csr_mcycle = target;
+}
+#endif
+
+// ------------------------------------------------------------
+// Hart Step Function
+// ------------------------------------------------------------
+void hart_step(Hart& h, volatile uint32_t* imem, volatile uint32_t* dmem, int max_cycles, int* cycles_output) {
+    #pragma HLS INLINE
 
     // =========================================================
     #ifdef __SYNTHESIS__
-        pc = 0x80000000; // Hardcode the default boot address for the FPGA
-        for(int i=0; i<32; i++) regfile[i] = 0;
+        h.pc = 0x80000000; // Hardcode the default boot address for the FPGA
+        for(int i=0; i<32; i++) h.regfile[i] = 0;
         
         // Setup default stack pointer for hardware (e.g., 64MB into DDR)
-        regfile[2] = 0x80000000 + 0x4000000; 
+        h.regfile[2] = 0x80000000 + 0x4000000; 
 
         // Reset CSRs
-        csr_mcycle = 0;
-        csr_minstret = 0;
-        csr_mstatus = 0;
-        csr_mie = 0;
-        csr_mip = 0;
-        mtimecmp = 0xFFFFFFFFFFFFFFFF;
-        lr_valid = false;
+        h.csr_mcycle = 0;
+        h.csr_minstret = 0;
+        h.csr_mstatus = 0;
+        h.csr_mie = 0;
+        h.csr_mip = 0;
+        h.mtimecmp = 0xFFFFFFFFFFFFFFFF;
+        h.lr_valid = false;
+        irq_schedule(h);
+        icache_invalidate(h); // The host may have loaded a new program
+        dcache_invalidate(h);
     #endif
     // =========================================================
 
-    is_finished = false;
+    h.is_finished = false;
 
     INSTRUCTION_LOOP: while(true) {
         #pragma HLS LOOP_TRIPCOUNT min=50 max=500000
 
+        #ifndef __SYNTHESIS__
+        // ------------------ Block Engine (C-Sim Only) ------------------
+        // Runs as far as it safely can; the code below then single-steps
+        // the instruction that needs exact per-cycle handling.
+        if (CORE_BLOCK_ENGINE && !CORE_LOG) {
+            if (run_blocks(h, imem, dmem, max_cycles)) {
+                h.is_finished = true;
+                dcache_flush(h, dmem);
+                *cycles_output = (int)(uword_t)h.csr_mcycle;
+                return;
+            }
+        }
+        if (h.sim->stop) { // hart_stop
+            h.sim->stop = false;
+            dcache_flush(h, dmem);
+            *cycles_output = (int)(uword_t)h.csr_mcycle;
+            uart_flush(*h.sim);
+            return;
+        }
+        #endif
+
         // ------------------ Cycle Counter ------------------
-        csr_mcycle++;
+        h.csr_mcycle++;
 
         // --- HEARTBEAT ---
-        if (csr_mcycle % 1000000 == 0) {
+        if (h.csr_mcycle % 1000000 == 0) {
             #ifdef __SYNTHESIS__
             // Do nothing
             #else
-            std::cout << "Cycle: " << std::dec << (uint64_t)csr_mcycle 
-                      << " | PC: 0x" << std::hex << (unsigned)pc << std::endl;
+            uart_flush(*h.sim);
+            std::cout << "Cycle: " << std::dec << (uint64_t)h.csr_mcycle 
+                      << " | PC: 0x" << std::hex << (unsigned)h.pc << std::endl;
             #endif
         }
 
         // ------------------ INTERRUPT LOGIC  ------------------
-        bool timer_irq = (csr_mcycle >= mtimecmp);
-
-        bool global_ie = (csr_mstatus >> 3) & 1;
-        bool timer_ie  = (csr_mie >> 7) & 1;
-
-        if (timer_irq) csr_mip |= (1 << 7);
-        else           csr_mip &= ~(1 << 7);
-
-        if (timer_irq && global_ie && timer_ie) {
-            if (CORE_DEBUG) std::cout << "[INT] Timer Interrupt! Jumping to Handler.\n";
-            
-            csr_mcause = 0x80000007;
-            csr_mepc   = pc;
+        // One compare per cycle; irq_schedule keeps the deadline current
+        if (h.csr_mcycle >= h.irq_deadline) {
+            if (CORE_LOG) std::cout << "[INT] Timer Interrupt! Jumping to Handler.\n";
             
-            bool old_mie = (csr_mstatus >> 3) & 1;
-            if (old_mie) csr_mstatus |= (1 << 7);
-            else         csr_mstatus &= ~(1 << 7);
-            
-            csr_mstatus &= ~(1 << 3);
-            pc = csr_mtvec; 
+            h.csr_mcause = 0x80000007;
+            h.csr_mepc   = h.pc;
+            mstatus_trap(h);
+            #ifndef __SYNTHESIS__
+            if (h.sim->prof) prof_count(*h.sim, (unsigned)h.pc, 0, 1); // Trap entry cycle
+            call_event(h, HART_TRAP, (unsigned)h.pc, (unsigned)h.csr_mtvec);
+            #endif
+            h.pc = h.csr_mtvec; 
             continue; 
         }
 
         // ------------------ Execute Pipeline ------------------
-        FetchOut  f = fetch(ram);
-        DecodeOut d = decode(f);
-        ExecOut   e = execute(d);
-        MemOut    m = memory(ram, e);
-        writeback(m);
+        #ifdef __SYNTHESIS__
+        FetchOut  f = fetch(h, imem);
+        DecodeOut d = decode(h, f);
+        #else
+        DecodeOut d = fetch_decode_cached(h, imem);
+        #endif
+        ExecOut   e = execute(h, d);
+        MemOut    m = memory(h, dmem, e);
+        writeback(h, m);
 
         // Instruction retired
-        csr_minstret++;
+        h.csr_minstret++;
 
         // ========== NEXT PC ==========
         if (e.branch_taken) {
-            pc = e.next_pc;
+            h.pc = e.next_pc;
         } else {
-            pc += 4;
+            h.pc += 4;
         }
 
+        #ifndef __SYNTHESIS__
+        if (h.sim->retire_hook) retire_event(*h.sim, d, e, m);
+        if (h.sim->prof) prof_count(*h.sim, (unsigned)(uword_t)d.pc, 1, 1);
+        if ((unsigned)d.instr == WFI_INSTR) wfi_idle(h, (unsigned)(uword_t)d.pc, max_cycles);
+        #endif
+
         // Break loop if ecall exit or cycle limit reached (0 = run forever)
-        if (e.finished || (max_cycles > 0 && (int)(ap_uint<32>)csr_mcycle >= max_cycles)) {
-            *cycles_output = (int)(ap_uint<32>)csr_mcycle;
+        if (e.finished || (max_cycles > 0 && (int)(uword_t)h.csr_mcycle >= max_cycles)) {
+            h.is_finished = e.finished; // false: stopped by the cycle limit
+            dcache_flush(h, dmem);       // The host reads results from DDR
+            *cycles_output = (int)(uword_t)h.csr_mcycle;
+            #ifndef __SYNTHESIS__
+            uart_flush(*h.sim); // Console output so far, before the caller prints
+            #endif
             return;
         }
     }
-}
\ No newline at end of file
+}
+
+#ifndef __SYNTHESIS__
+// ------------------------------------------------------------
+// Five-Stage Pipeline Model (C-Sim Only)
+// ------------------------------------------------------------
+// IF / ID / EX / MEM / WB built from the same stage functions, with their
+// output structs as the pipeline registers. One loop iteration advances
+// every stage by one step, and mcycle counts steps here, not instructions.
+// The stages are evaluated back to front, each reading its input register
+// before the stage behind it overwrites it:
+//   WB   writes the register file first (ID reads it later in the cycle)
+//   MEM  the load / store / AMO EX produced last cycle
+//   EX   operands forwarded from MEM, then WB. The commit point: traps,
+//        CSRs, MRET and taken branches act here and flush IF and ID.
+//   ID   stalls one cycle on a load-use hazard, and holds SYSTEM
+//        instructions while EX is busy (ECALL reads a7 from the regfile)
+//   IF   fetches h.pc, predicting not taken
+// A taken branch or jump costs two bubbles. The timer interrupt is taken
+// in EX, with mepc = the pc of the instruction it displaces. On exit the
+// committed instructions drain and h.pc is the oldest one not executed,
+// so a later call resumes exactly.
+//
+// This is a cycle model, not a synthesis top. mcycle counts the clocks of
+// an ideal pipeline in which every cache access, line fill and divide
+// completes in its stage's one clock, so the cycle counts bound the CPI
+// from below. A hardware version would need misses, FENCE.I flushes and
+// divides moved into a stall state machine outside the loop body, and a
+// register file with a third port (two ID reads plus the WB write).
+static inline bool pipe_reads_rs1(const DecodeOut& d) {
+    unsigned op = (unsigned)d.opcode;
+    return op != 0x37 && op != 0x17 && op != 0x6F; // LUI, AUIPC, JAL
+}
+
+static inline bool pipe_reads_rs2(const DecodeOut& d) {
+    unsigned op = (unsigned)d.opcode;
+    return op == 0x33 || op == 0x23 || op == 0x63 || op == 0x2F;
+}
+
+// Newest value of 'rs': the instruction in MEM, then the one in WB
+static inline sword_t pipe_forward(regidx_t rs, sword_t val, const MemOut& mem, bool mem_v, const MemOut& wb, bool wb_v) {
+    if (rs == 0) return 0;
+    if (mem_v && mem.reg_write && !mem.is_trap && mem.rd == rs) return mem.value;
+    if (wb_v && wb.reg_write && !wb.is_trap && wb.rd == rs) return wb.value;
+    return val;
+}
+
+void hart_step_pipelined(Hart& h, volatile uint32_t* imem, volatile uint32_t* dmem, int max_cycles, int* cycles_output) {
+    h.is_finished = false;
+
+    // Pipeline registers and their valid bits
+    FetchOut  if_id  = FetchOut();  bool if_v = false;
+    DecodeOut id_ex  = DecodeOut(); bool id_v = false;
+    ExecOut   ex_mem = ExecOut();   bool ex_v = false;
+    MemOut    mem_wb = MemOut();    bool wb_v = false;
+    DecodeOut ex_mem_d = DecodeOut(), mem_wb_d = DecodeOut(); // Retire hook: the decoded
+    ExecOut   mem_wb_e = ExecOut();                           // instruction travels along
+
+    bool    draining  = false; // Stopped: finish MEM / WB, issue nothing
+    uword_t resume_pc = 0;
+
+    PIPELINE_LOOP: while (true) {
+        if (draining && !ex_v && !wb_v) break;
+
+        bool stop = max_cycles > 0 && (int)(uword_t)h.csr_mcycle >= max_cycles;
+        stop = stop || h.sim->stop; // hart_stop
+        if (stop && !draining) {
+            draining  = true;
+            resume_pc = id_v ? (uword_t)id_ex.pc : if_v ? if_id.pc : h.pc;
+        }
+
+        // ------------------ Cycle Counter ------------------
+        h.csr_mcycle++;
+
+        // --- HEARTBEAT ---
+        if (h.csr_mcycle % 1000000 == 0) {
+            uart_flush(*h.sim);
+            std::cout << "Cycle: " << std::dec << (uint64_t)h.csr_mcycle 
+                      << " | PC: 0x" << std::hex << (unsigned)h.pc << std::endl;
+        }
+
+        // ------------------ WB ------------------
+        if (wb_v) {
+            writeback(h, mem_wb);
+            h.csr_minstret++;
+            if (h.sim->retire_hook) retire_event(*h.sim, mem_wb_d, mem_wb_e, mem_wb);
+            if ((unsigned)mem_wb_d.instr == WFI_INSTR) wfi_idle(h, (unsigned)(uword_t)mem_wb_d.pc, max_cycles);
+        }
+
+        // ------------------ MEM ------------------
+        MemOut m   = MemOut();
+        bool   m_v = ex_v;
+        if (ex_v) m = memory(h, dmem, ex_mem);
+
+        // ------------------ EX ------------------
+        ExecOut   e    = ExecOut();
+        DecodeOut d_ex = id_ex;
+        bool      e_v      = false;
+        bool      redirect = false;
+        uword_t   target   = 0;
+        if (id_v && !draining) {
+            if (h.csr_mcycle >= h.irq_deadline) {
+                if (CORE_LOG) std::cout << "[INT] Timer Interrupt! Jumping to Handler.\n";
+                h.csr_mcause = 0x80000007;
+                h.csr_mepc   = (uword_t)id_ex.pc;
+                mstatus_trap(h);
+                call_event(h, HART_TRAP, (unsigned)(uword_t)id_ex.pc, (unsigned)h.csr_mtvec);
+                redirect = true;
+                target   = h.csr_mtvec;
+            } else {
+                d_ex.rs1_val = pipe_forward(d_ex.rs1, d_ex.rs1_val, m, m_v, mem_wb, wb_v);
+                d_ex.rs2_val = pipe_forward(d_ex.rs2, d_ex.rs2_val, m, m_v, mem_wb, wb_v);
+                e   = execute(h, d_ex);
+                e_v = true;
+                if (e.branch_taken) {
+                    redirect = true;
+                    target   = e.next_pc;
+                } else if (d_ex.opcode == 0x0F && d_ex.funct3 == 0x1) { // FENCE.I: refetch
+                    redirect = true;
+                    target   = (uword_t)wrap_add(d_ex.pc, 4);
+                }
+                if (e.finished) {
+                    h.is_finished = true;
+                    draining      = true;
+                    resume_pc     = target;
+                }
+            }
+        }
+
+        // ------------------ ID ------------------
+        DecodeOut d  = DecodeOut();
+        bool d_v   = false;
+        bool stall = false;
+        if (if_v && !redirect && !draining) {
+            d = decode(h, if_id);
+            bool load_in_ex = e_v && (e.mem_read || e.is_atomic) && !e.is_trap && e.rd != 0;
+            if (load_in_ex && ((pipe_reads_rs1(d) && d.rs1 == e.rd) || (pipe_reads_rs2(d) && d.rs2 == e.rd))) {
+                stall = true; // Load-use: wait for the load to reach WB
+            }
+            if (d.opcode == 0x73 && e_v) {
+                stall = true; // SYSTEM: wait until nothing is in flight ahead of WB
+            }
+            d_v = !stall;
+        }
+
+        // ------------------ IF ------------------
+        if (!draining) {
+            if (redirect) {
+                h.pc = target;
+                if_v = false;
+            } else if (!stall) {
+                if_id = fetch(h, imem);
+                if_v  = true;
+                h.pc  = h.pc + 4;
+            }
+        } else {
+            if_v = false;
+        }
+
+        // ------------------ Advance ------------------
+        mem_wb_d = ex_mem_d;
+        mem_wb_e = ex_mem;
+        ex_mem_d = d_ex;
+        mem_wb = m;
+        wb_v   = m_v;
+        ex_mem = e;
+        ex_v   = e_v;
+        id_ex  = d;
+        id_v   = d_v;
+    }
+
+    h.pc = resume_pc;
+    dcache_flush(h, dmem);
+    *cycles_output = (int)(uword_t)h.csr_mcycle;
+    h.sim->stop = false;
+    uart_flush(*h.sim); // Console output so far, before the caller prints
+}
+#endif
+
+// ------------------------------------------------------------
+// Top-Level Step Function
+// ------------------------------------------------------------
+// The synthesized core (and the single-core testbenches) run one built-in
+// hart. DISAGGREGATE maps its fields to individual registers; the register
+// file stays a LUTRAM and each I- and D-cache way gets its own BRAM. The
+// valid and dirty bits are registers, so a reset clears them in one cycle.
+static Hart core_hart;
+
+void riscv_init() {
+    hart_init(core_hart, (uword_t)(unsigned)ENTRY_PC);
+}
+
+void riscv_step(volatile uint32_t* imem, volatile uint32_t* dmem, int max_cycles, int* cycles_output) {
+    // In hardware, driver must set m_axi base address to 0x0 so the core can
+    // address both DDR (0x80000000) and UART (0x10000000) via SmartConnect routing.
+    // Two masters onto the same memory: imem only reads I-cache lines, dmem
+    // carries D-cache line bursts plus single-word UART accesses, so neither
+    // waits behind the other. Bursts are sized for lines of up to 16 words.
+    #pragma HLS INTERFACE m_axi port=imem offset=off depth=262144 bundle=imem max_read_burst_length=16 num_read_outstanding=4
+    #pragma HLS INTERFACE m_axi port=dmem offset=off depth=262144 bundle=dmem max_read_burst_length=16 max_write_burst_length=16
+    // Control Parameters
+    #pragma HLS INTERFACE s_axilite port=max_cycles bundle=control
+    #pragma HLS INTERFACE s_axilite port=cycles_output bundle=control
+    // AXI Lite Interface for Control
+    #pragma HLS INTERFACE s_axilite port=return bundle=control
+    #pragma HLS DISAGGREGATE variable=core_hart
+    #pragma HLS BIND_STORAGE variable=core_hart.regfile type=ram_2p impl=lutram
+    #pragma HLS ARRAY_PARTITION variable=core_hart.icache_data type=complete dim=1
+    #pragma HLS ARRAY_PARTITION variable=core_hart.icache_tag type=complete dim=1
+    #pragma HLS ARRAY_PARTITION variable=core_hart.icache_valid type=complete dim=0
+    #pragma HLS BIND_STORAGE variable=core_hart.icache_data type=ram_2p impl=bram
+    #pragma HLS ARRAY_PARTITION variable=core_hart.dcache_data type=complete dim=1
+    #pragma HLS ARRAY_PARTITION variable=core_hart.dcache_tag type=complete dim=1
+    #pragma HLS ARRAY_PARTITION variable=core_hart.dcache_valid type=complete dim=0
+    #pragma HLS ARRAY_PARTITION variable=core_hart.dcache_dirty type=complete dim=0
+    #pragma HLS BIND_STORAGE variable=core_hart.dcache_data type=ram_2p impl=bram
+
+    hart_step(core_hart, imem, dmem, max_cycles, cycles_output);
+}
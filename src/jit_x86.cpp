@@ -0,0 +1,360 @@
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "jit_x86.h"
+
+// ------------------------------------------------------------
+// Host Support
+// ------------------------------------------------------------
+// SysV (Linux/macOS) and Win64 calling conventions are both handled.
+// Any other host reports jit_available() == false and the core keeps
+// interpreting.
+#if defined(__x86_64__) || defined(_M_X64)
+    #define JIT_HOST_X86_64 1
+    #ifdef _WIN32
+        #include <windows.h>
+    #else
+        #include <sys/mman.h>
+    #endif
+#else
+    #define JIT_HOST_X86_64 0
+#endif
+
+#define JIT_CODE_SIZE  (16 * 1024 * 1024)
+#define JIT_MAX_INSN_BYTES 160 // Worst case for one translated instruction
+
+// One executable buffer per cache, so harts on different threads never
+// share (or reset) each other's code.
+struct JitCache {
+    uint8_t* code_buf;
+    size_t   code_used;
+};
+
+bool jit_available() {
+    return JIT_HOST_X86_64 != 0;
+}
+
+JitCache* jit_create() {
+    uint8_t* buf = 0;
+    #if JIT_HOST_X86_64
+        #ifdef _WIN32
+            buf = (uint8_t*)VirtualAlloc(0, JIT_CODE_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
+        #else
+            void* p = mmap(0, JIT_CODE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            buf = (p == MAP_FAILED) ? 0 : (uint8_t*)p;
+        #endif
+    #endif
+    if (!buf) return 0;
+    JitCache* c = new JitCache;
+    c->code_buf  = buf;
+    c->code_used = 0;
+    return c;
+}
+
+void jit_destroy(JitCache* c) {
+    if (!c) return;
+    #if JIT_HOST_X86_64
+        #ifdef _WIN32
+            VirtualFree(c->code_buf, 0, MEM_RELEASE);
+        #else
+            munmap(c->code_buf, JIT_CODE_SIZE);
+        #endif
+    #endif
+    delete c;
+}
+
+void jit_reset(JitCache* c) {
+    if (c) c->code_used = 0;
+}
+
+// ------------------------------------------------------------
+// x86-64 Register Numbers / ABI
+// ------------------------------------------------------------
+enum { RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSP = 4, RSI = 6, RDI = 7,
+       R8 = 8, R9 = 9, R12 = 12, R13 = 13 };
+
+#ifdef _WIN32
+static const int ARG0 = RCX, ARG1 = RDX, ARG2 = R8, ARG3 = R9;
+static const int SHADOW_SPACE = 32;
+#else
+static const int ARG0 = RDI, ARG1 = RSI, ARG2 = RDX, ARG3 = RCX;
+static const int SHADOW_SPACE = 0;
+#endif
+
+// Pinned registers inside translated code
+static const int REG_FILE = RBX; // int32_t regs[32]
+static const int REG_CTX  = R12; // Core context for helpers
+
+// ------------------------------------------------------------
+// Emitter
+// ------------------------------------------------------------
+struct Emitter {
+    uint8_t* p;
+    std::vector<uint8_t*> exit_jumps; // rel32 fields that jump to the epilogue
+
+    void b(uint8_t v)   { *p++ = v; }
+    void d(uint32_t v)  { memcpy(p, &v, 4); p += 4; }
+    void q(uint64_t v)  { memcpy(p, &v, 8); p += 8; }
+
+    void rex(bool w, int reg, int rm) {
+        uint8_t r = 0x40 | (w ? 8 : 0) | ((reg >> 3) << 2) | (rm >> 3);
+        if (r != 0x40) b(r);
+    }
+    void modrm(int mod, int reg, int rm) { b((uint8_t)((mod << 6) | ((reg & 7) << 3) | (rm & 7))); }
+
+    // op r/m, reg (register direct)
+    void op_rr(uint8_t op, int reg, int rm, bool w = false) { rex(w, reg, rm); b(op); modrm(3, reg, rm); }
+
+    void push(int r) { rex(false, 0, r); b(0x50 + (r & 7)); }
+    void pop(int r)  { rex(false, 0, r); b(0x58 + (r & 7)); }
+
+    void mov_r32_imm(int r, uint32_t imm) { rex(false, 0, r); b(0xB8 + (r & 7)); d(imm); }
+    void mov_r64_imm(int r, uint64_t imm) { rex(true, 0, r); b(0xB8 + (r & 7)); q(imm); }
+    void mov_r32_r32(int dst, int src)    { op_rr(0x89, src, dst); }
+    void mov_r64_r64(int dst, int src)    { op_rr(0x89, src, dst, true); }
+
+    // RISC-V register <-> x86 register (x0 reads as zero, writes are dropped)
+    void load_x(int r, unsigned x) {
+        if (x == 0) { op_rr(0x31, r, r); return; }         // xor r, r
+        rex(false, r, REG_FILE); b(0x8B); modrm(1, r, REG_FILE); b((uint8_t)(x * 4));
+    }
+    void store_x(unsigned x, int r) {
+        if (x == 0) return;
+        rex(false, r, REG_FILE); b(0x89); modrm(1, r, REG_FILE); b((uint8_t)(x * 4));
+    }
+
+    // Group-1 ALU op with imm32: 0=add 1=or 4=and 6=xor 7=cmp
+    void alu_imm(int ext, int r, uint32_t imm) { rex(false, 0, r); b(0x81); modrm(3, ext, r); d(imm); }
+    // Shift by imm8 / by cl: 4=shl 5=shr 7=sar
+    void shift_imm(int ext, int r, uint8_t n) { rex(false, 0, r); b(0xC1); modrm(3, ext, r); b(n); }
+    void shift_cl(int ext, int r)             { rex(false, 0, r); b(0xD3); modrm(3, ext, r); }
+    void shr_r64_imm(int r, uint8_t n)        { rex(true, 0, r);  b(0xC1); modrm(3, 5, r); b(n); }
+
+    void setcc_zx(uint8_t cc, int r) { // setcc r8; movzx r32, r8 (r < 4)
+        b(0x0F); b(0x90 | cc); modrm(3, 0, r);
+        b(0x0F); b(0xB6); modrm(3, r, r);
+    }
+
+    void call_abs(const void* fn) { mov_r64_imm(RAX, (uint64_t)(uintptr_t)fn); b(0xFF); modrm(3, 2, RAX); }
+
+    uint8_t* jcc32(uint8_t cc) { b(0x0F); b(0x80 | cc); uint8_t* f = p; d(0); return f; }
+    uint8_t* jmp32()           { b(0xE9); uint8_t* f = p; d(0); return f; }
+    void bind(uint8_t* field, uint8_t* target) {
+        int32_t rel = (int32_t)(target - (field + 4));
+        memcpy(field, &rel, 4);
+    }
+
+    // rax = (retired << 32) | next_pc, then leave
+    void exit_const(uint32_t next_pc, unsigned retired) {
+        mov_r32_imm(RAX, next_pc);
+        exit_rax(retired);
+    }
+    // rax[31:0] already holds next_pc (upper half is zero after a 32-bit op)
+    void exit_rax(unsigned retired) {
+        mov_r64_imm(RDX, (uint64_t)retired << 32);
+        op_rr(0x09, RDX, RAX, true);                       // or rax, rdx
+        exit_jumps.push_back(jmp32());
+    }
+};
+
+// x86 condition codes
+enum { CC_B = 0x2, CC_AE = 0x3, CC_E = 0x4, CC_NE = 0x5, CC_L = 0xC, CC_GE = 0xD };
+
+// ------------------------------------------------------------
+// Supported Subset
+// ------------------------------------------------------------
+// CSR/SYSTEM, FENCE, AMO and anything that would trap stay in the
+// interpreter; a translation ends right before them.
+static bool is_supported(const JitInsn& in) {
+    switch (in.opcode) {
+        case 0x37: case 0x17: case 0x13: case 0x6F: case 0x67:
+            return true;
+        case 0x33:
+            if (in.funct7 == 0x00 || in.funct7 == 0x01) return true;
+            if (in.funct7 == 0x20) return in.funct3 == 0x0 || in.funct3 == 0x5;
+            return false;
+        case 0x03:
+            return in.funct3 == 0 || in.funct3 == 1 || in.funct3 == 2 || in.funct3 == 4 || in.funct3 == 5;
+        case 0x23:
+            return in.funct3 <= 2;
+        case 0x63:
+            return in.funct3 != 2 && in.funct3 != 3;
+        default:
+            return false;
+    }
+}
+
+static bool is_terminator(uint8_t opcode) {
+    return opcode == 0x63 || opcode == 0x6F || opcode == 0x67;
+}
+
+// ------------------------------------------------------------
+// Translator
+// ------------------------------------------------------------
+JitFn jit_compile(JitCache* c, const JitInsn* insns, unsigned count, uint32_t pc, const JitHelpers& h) {
+    if (!c) return 0;
+
+    unsigned n = 0;
+    while (n < count && is_supported(insns[n])) {
+        n++;
+        if (is_terminator(insns[n - 1].opcode)) break;
+    }
+    if (n == 0) return 0;
+
+    size_t worst = 64 + (size_t)n * JIT_MAX_INSN_BYTES;
+    if (c->code_used + worst > JIT_CODE_SIZE) return 0;
+
+    Emitter e;
+    e.p = c->code_buf + c->code_used;
+    uint8_t* entry = e.p;
+
+    // ---- Prologue ----
+    e.push(RBX); e.push(R12); e.push(R13); // Three pushes keep rsp 16-byte aligned
+    if (SHADOW_SPACE) { e.rex(true, 0, RSP); e.b(0x83); e.modrm(3, 5, RSP); e.b(SHADOW_SPACE); }
+    e.mov_r64_r64(REG_FILE, ARG0);
+    e.mov_r64_r64(REG_CTX, ARG1);
+
+    bool ended = false;
+    for (unsigned k = 0; k < n; k++) {
+        const JitInsn& in = insns[k];
+        uint32_t ipc = pc + 4 * k;
+
+        switch (in.opcode) {
+        case 0x37: // LUI
+            e.mov_r32_imm(RAX, in.instr & 0xFFFFF000);
+            e.store_x(in.rd, RAX);
+            break;
+        case 0x17: // AUIPC
+            e.mov_r32_imm(RAX, ipc + (in.instr & 0xFFFFF000));
+            e.store_x(in.rd, RAX);
+            break;
+        case 0x13: { // I-type ALU
+            uint8_t shamt = (uint8_t)(in.imm & 0x1F);
+            e.load_x(RAX, in.rs1);
+            switch (in.funct3) {
+                case 0x0: e.alu_imm(0, RAX, (uint32_t)in.imm); break;                           // ADDI
+                case 0x1: e.shift_imm(4, RAX, shamt); break;                                    // SLLI
+                case 0x2: e.alu_imm(7, RAX, (uint32_t)in.imm); e.setcc_zx(CC_L, RAX); break;    // SLTI
+                case 0x3: e.alu_imm(7, RAX, (uint32_t)in.imm); e.setcc_zx(CC_B, RAX); break;    // SLTIU
+                case 0x4: e.alu_imm(6, RAX, (uint32_t)in.imm); break;                           // XORI
+                case 0x5: e.shift_imm((in.instr >> 30) & 1 ? 7 : 5, RAX, shamt); break;         // SRLI/SRAI
+                case 0x6: e.alu_imm(1, RAX, (uint32_t)in.imm); break;                           // ORI
+                case 0x7: e.alu_imm(4, RAX, (uint32_t)in.imm); break;                           // ANDI
+            }
+            e.store_x(in.rd, RAX);
+            break;
+        }
+        case 0x33: { // R-type
+            e.load_x(RAX, in.rs1);
+            e.load_x(RCX, in.rs2);
+            if (in.funct7 == 0x01) {
+                if (in.funct3 == 0x0) {
+                    e.b(0x0F); e.b(0xAF); e.modrm(3, RAX, RCX);                                 // MUL (imul eax, ecx)
+                } else {
+                    // MULH*/DIV*/REM*: let the core compute it
+                    e.mov_r32_imm(ARG1, in.instr);
+                    e.mov_r32_r32(ARG2, RAX);
+                    e.mov_r32_r32(ARG3, RCX);
+                    e.mov_r64_r64(ARG0, REG_CTX);
+                    e.call_abs((const void*)h.alu);
+                }
+            } else if (in.funct7 == 0x20) {
+                if (in.funct3 == 0x0) e.op_rr(0x29, RCX, RAX);                                  // SUB
+                else                  e.shift_cl(7, RAX);                                       // SRA
+            } else {
+                switch (in.funct3) {
+                    case 0x0: e.op_rr(0x01, RCX, RAX); break;                                   // ADD
+                    case 0x1: e.shift_cl(4, RAX); break;                                        // SLL
+                    case 0x2: e.op_rr(0x39, RCX, RAX); e.setcc_zx(CC_L, RAX); break;            // SLT
+                    case 0x3: e.op_rr(0x39, RCX, RAX); e.setcc_zx(CC_B, RAX); break;            // SLTU
+                    case 0x4: e.op_rr(0x31, RCX, RAX); break;                                   // XOR
+                    case 0x5: e.shift_cl(5, RAX); break;                                        // SRL
+                    case 0x6: e.op_rr(0x09, RCX, RAX); break;                                   // OR
+                    case 0x7: e.op_rr(0x21, RCX, RAX); break;                                   // AND
+                }
+            }
+            e.store_x(in.rd, RAX);
+            break;
+        }
+        case 0x03: { // Load
+            e.load_x(RAX, in.rs1);
+            e.alu_imm(0, RAX, (uint32_t)in.imm);
+            e.mov_r32_r32(ARG1, RAX);
+            e.mov_r32_imm(ARG2, in.funct3);
+            e.mov_r64_r64(ARG0, REG_CTX);
+            e.call_abs((const void*)h.load);
+            // Not handled (MMIO / out of range): hand this instruction back
+            e.mov_r64_r64(RDX, RAX);
+            e.shr_r64_imm(RDX, 32);
+            e.op_rr(0x85, RDX, RDX);                                                            // test edx, edx
+            uint8_t* ok = e.jcc32(CC_E);
+            e.exit_const(ipc, k);
+            e.bind(ok, e.p);
+            e.store_x(in.rd, RAX);
+            break;
+        }
+        case 0x23: { // Store
+            e.load_x(RAX, in.rs1);
+            e.alu_imm(0, RAX, (uint32_t)in.imm);
+            e.load_x(RCX, in.rs2);
+            e.mov_r32_r32(ARG1, RAX);
+            e.mov_r32_r32(ARG2, RCX);
+            e.mov_r32_imm(ARG3, in.funct3);
+            e.mov_r64_r64(ARG0, REG_CTX);
+            e.call_abs((const void*)h.store);
+            e.op_rr(0x85, RAX, RAX);                                                            // test eax, eax
+            uint8_t* ok = e.jcc32(CC_E);
+            e.alu_imm(7, RAX, 1);                                                               // cmp eax, 1
+            uint8_t* modified = e.jcc32(CC_NE);
+            e.exit_const(ipc, k);                                                               // 1: not handled
+            e.bind(modified, e.p);
+            e.exit_const(ipc + 4, k + 1);                                                       // 2: code changed
+            e.bind(ok, e.p);
+            break;
+        }
+        case 0x63: { // Branch
+            static const uint8_t cc_for[8] = { CC_E, CC_NE, 0, 0, CC_L, CC_GE, CC_B, CC_AE };
+            e.load_x(RAX, in.rs1);
+            e.load_x(RCX, in.rs2);
+            e.op_rr(0x39, RCX, RAX);                                                            // cmp eax, ecx
+            uint8_t* taken = e.jcc32(cc_for[in.funct3]);
+            e.exit_const(ipc + 4, k + 1);
+            e.bind(taken, e.p);
+            e.exit_const(ipc + (uint32_t)in.imm, k + 1);
+            ended = true;
+            break;
+        }
+        case 0x6F: // JAL
+            e.mov_r32_imm(RAX, ipc + 4);
+            e.store_x(in.rd, RAX);
+            e.exit_const(ipc + (uint32_t)in.imm, k + 1);
+            ended = true;
+            break;
+        case 0x67: // JALR (target computed before rd is written: rd may equal rs1)
+            e.load_x(RCX, in.rs1);
+            e.alu_imm(0, RCX, (uint32_t)in.imm);
+            e.alu_imm(4, RCX, 0xFFFFFFFE);
+            e.mov_r32_imm(RAX, ipc + 4);
+            e.store_x(in.rd, RAX);
+            e.mov_r32_r32(RAX, RCX);
+            e.exit_rax(k + 1);
+            ended = true;
+            break;
+        }
+    }
+
+    // Ran off the end of the translated prefix
+    if (!ended) e.exit_const(pc + 4 * n, n);
+
+    // ---- Epilogue ----
+    uint8_t* epilogue = e.p;
+    if (SHADOW_SPACE) { e.rex(true, 0, RSP); e.b(0x83); e.modrm(3, 0, RSP); e.b(SHADOW_SPACE); }
+    e.pop(R13); e.pop(R12); e.pop(RBX);
+    e.b(0xC3);
+
+    for (size_t i = 0; i < e.exit_jumps.size(); i++) e.bind(e.exit_jumps[i], epilogue);
+
+    c->code_used = (size_t)(e.p - c->code_buf);
+    c->code_used = (c->code_used + 15) & ~(size_t)15;
+    return (JitFn)entry;
+}